@@ -0,0 +1,309 @@
+#include "binary_format.h"
+#include "block_growth.h"
+#include "block_model.h"
+#include "line_reader.h"
+#include "model_generator.h"
+#include "row_kernels.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+using std::string;
+
+// Throughput benchmarks over a synthetic model (see model_generator.h).
+// Parse, growth and output are timed separately, then the whole program is
+// timed end to end. Each benchmark repeats until it has run for --min-time
+// seconds and reports the mean time per iteration plus voxels/s and blocks/s
+// over all iterations, in the style of Google Benchmark.
+
+namespace {
+
+// Work done by one iteration of a benchmark
+struct Counters {
+  std::uint64_t voxels = 0;
+  std::uint64_t blocks = 0;
+};
+
+// Stream buffer that discards everything, standing in for stdout
+class NullBuffer : public std::streambuf {
+protected:
+  int overflow(int c) override { return c; }
+  std::streamsize xsputn(const char*, std::streamsize n) override { return n; }
+};
+
+// Counts emitted blocks without keeping them
+class CountingSink : public BlockSink {
+public:
+  std::uint64_t blocks = 0;
+
+  void emit(const Block&) override { ++blocks; }
+};
+
+struct Options {
+  ModelParams model;
+  double min_time = 0.5;
+  string filter;
+  unsigned int threads = std::max(1u, std::thread::hardware_concurrency());
+};
+
+// The generated model in the forms the benchmarks start from
+struct Fixture {
+  string text;                       // input format
+  Flat3D<char> voxels;               // [z_count][y_count][x_count]
+  std::unordered_map<char, string> tag_table;
+  std::vector<Block> blocks;         // greedy output, in output order
+  std::vector<std::size_t> slab_end; // blocks[] index where each slab ends
+};
+
+// "1.23G/s"
+string format_rate(double per_second) {
+  const char* units[] = {"", "k", "M", "G", "T"};
+  int u = 0;
+  while (per_second >= 1000.0 && u < 4) {
+    per_second /= 1000.0;
+    ++u;
+  }
+  char buf[32];
+  std::snprintf(buf, sizeof(buf), "%.3g%s/s", per_second, units[u]);
+  return buf;
+}
+
+// "12.3 ms"
+string format_time(double seconds) {
+  const char* units[] = {"s", "ms", "us", "ns"};
+  int u = 0;
+  while (seconds < 1.0 && u < 3) {
+    seconds *= 1000.0;
+    ++u;
+  }
+  char buf[32];
+  std::snprintf(buf, sizeof(buf), "%.3g %s", seconds, units[u]);
+  return buf;
+}
+
+void print_header() {
+  char line[128];
+  std::snprintf(line, sizeof(line), "%-32s %12s %12s %14s %14s", "Benchmark", "Time", "Iterations", "voxels/s",
+                "blocks/s");
+  string rule(std::strlen(line), '-');
+  std::cout << rule << "\n" << line << "\n" << rule << "\n";
+}
+
+// Runs fn until min_time has elapsed (at least once) and prints a result row
+template <typename Fn>
+void run_benchmark(const Options& opts, const string& name, Fn fn) {
+  if (!opts.filter.empty() && name.find(opts.filter) == string::npos) return;
+
+  using clock = std::chrono::steady_clock;
+  Counters total;
+  std::uint64_t iterations = 0;
+  double elapsed = 0.0;
+  clock::time_point start = clock::now();
+  do {
+    Counters c = fn();
+    total.voxels += c.voxels;
+    total.blocks += c.blocks;
+    ++iterations;
+    elapsed = std::chrono::duration<double>(clock::now() - start).count();
+  } while (elapsed < opts.min_time);
+
+  char line[128];
+  std::snprintf(line, sizeof(line), "%-32s %12s %12llu %14s %14s", name.c_str(),
+                format_time(elapsed / iterations).c_str(), static_cast<unsigned long long>(iterations),
+                total.voxels ? format_rate(total.voxels / elapsed).c_str() : "",
+                total.blocks ? format_rate(total.blocks / elapsed).c_str() : "");
+  std::cout << line << std::endl;
+}
+
+// Calls fn(view, parent, last_in_slab) for every parent block, slab by slab
+// in output order
+template <typename Fn>
+void for_each_parent(const ModelParams& p, const Flat3D<char>& voxels, Fn fn) {
+  Flat3DView<const char> all(voxels);
+  for (int z = 0; z < p.z_count; z += p.parent_z) {
+    int d = std::min(p.parent_z, p.z_count - z);
+    for (int y = 0; y < p.y_count; y += p.parent_y) {
+      int h = std::min(p.parent_y, p.y_count - y);
+      for (int x = 0; x < p.x_count; x += p.parent_x) {
+        int w = std::min(p.parent_x, p.x_count - x);
+        Flat3DView<const char> view = all.sub(z, z + d, y, y + h, x, x + w);
+        fn(view, Block(x, y, z, w, h, d, view.at(0, 0, 0)), x + w == p.x_count && y + h == p.y_count);
+      }
+    }
+  }
+}
+
+bool is_uniform(const Flat3DView<const char>& view) {
+  for (int z = 0; z < view.depth; ++z)
+    for (int y = 0; y < view.height; ++y)
+      if (row_find_mismatch(&view.at(z, y, 0), view.width, view.at(0, 0, 0)) != view.width) return false;
+  return true;
+}
+
+Fixture make_fixture(const ModelParams& p) {
+  Fixture f;
+  std::ostringstream text;
+  ModelGenerator(p).write(text);
+  f.text = text.str();
+
+  ModelGenerator gen(p);
+  for (char tag : gen.tags()) f.tag_table[tag] = string("label_") + tag;
+  f.voxels = Flat3D<char>(p.z_count, p.y_count, p.x_count);
+  std::vector<char> plane;
+  for (int z = 0; z < p.z_count; ++z) {
+    gen.next_slice(plane);
+    std::memcpy(&f.voxels.at(z, 0, 0), plane.data(), plane.size());
+  }
+
+  BlockList list;
+  for_each_parent(p, f.voxels, [&](const Flat3DView<const char>& view, const Block& parent, bool slab_done) {
+    if (is_uniform(view))
+      list.emit(parent);
+    else
+      grow_parent_block(view, parent, GrowthStrategy::Greedy, list);
+    if (slab_done) f.slab_end.push_back(list.blocks.size());
+  });
+  f.blocks = std::move(list.blocks);
+  return f;
+}
+
+// Reads the model rows into a slab buffer, as the stdin path of BlockModel
+Counters bench_parse(const ModelParams& p, const Fixture& f) {
+  LineReader reader(f.text.data(), f.text.size());
+  const char* line;
+  std::size_t len;
+  do {
+    if (!reader.next_line(line, len)) throw std::runtime_error("Unexpected end of model header");
+  } while (len != 0);
+
+  Flat3D<char> slab(p.parent_z, p.y_count, p.x_count);
+  for (int z = 0; z < p.z_count; ++z) {
+    for (int y = 0; y < p.y_count; ++y) {
+      if (!reader.next_line(line, len) || len != static_cast<std::size_t>(p.x_count))
+        throw std::runtime_error("Bad model row");
+      std::memcpy(&slab.at(z % p.parent_z, y, 0), line, len);
+    }
+    reader.next_line(line, len); // blank line after the slice
+  }
+  return {p.voxels(), 0};
+}
+
+// Grows every mixed parent block, as BlockModel does (uniform ones are
+// emitted as they are)
+Counters bench_growth(const ModelParams& p, const Fixture& f, GrowthStrategy strategy) {
+  CountingSink sink;
+  for_each_parent(p, f.voxels, [&](const Flat3DView<const char>& view, const Block& parent, bool) {
+    if (is_uniform(view))
+      sink.emit(parent);
+    else
+      grow_parent_block(view, parent, strategy, sink);
+  });
+  return {p.voxels(), sink.blocks};
+}
+
+// Formats the greedy output and writes it a slab at a time
+Counters bench_output(const ModelParams& p, const Fixture& f, BlockBuffer& buffer) {
+  NullBuffer null_buf;
+  std::ostream out(&null_buf);
+  std::size_t i = 0;
+  for (std::size_t end : f.slab_end) {
+    for (; i < end; ++i) buffer.emit(f.blocks[i]);
+    buffer.write_to(out);
+    buffer.clear();
+  }
+  return {p.voxels(), f.blocks.size()};
+}
+
+// The whole program: text in on std::cin, text out on std::cout
+Counters bench_end_to_end(const ModelParams& p, const Fixture& f, unsigned int threads) {
+  std::istringstream in(f.text);
+  NullBuffer null_buf;
+  std::streambuf* old_in = std::cin.rdbuf(in.rdbuf());
+  std::streambuf* old_out = std::cout.rdbuf(&null_buf);
+  try {
+    BlockModel bm;
+    bm.set_num_threads(threads);
+    bm.read_specification();
+    bm.read_tag_table();
+    bm.read_model();
+  } catch (...) {
+    std::cin.rdbuf(old_in);
+    std::cout.rdbuf(old_out);
+    throw;
+  }
+  std::cin.rdbuf(old_in);
+  std::cout.rdbuf(old_out);
+  return {p.voxels(), f.blocks.size()};
+}
+
+void print_usage(const char* prog) {
+  std::cerr << "Usage: " << prog
+            << " [--size X,Y,Z] [--parent X,Y,Z] [--tags N] [--noise F] [--blobs N] [--blob-size N] [--seed N]"
+               " [--min-time SECONDS] [--filter SUBSTRING] [--threads N]\n";
+}
+
+} // namespace
+
+int main(int argc, char* argv[]) {
+  Options opts;
+  try {
+    for (int i = 1; i < argc; ++i) {
+      string arg = argv[i];
+      if (parse_model_option(argc, argv, i, opts.model)) continue;
+      if (arg == "--min-time" && i + 1 < argc) {
+        opts.min_time = std::stod(argv[++i]);
+      } else if (arg == "--filter" && i + 1 < argc) {
+        opts.filter = argv[++i];
+      } else if (arg == "--threads" && i + 1 < argc) {
+        opts.threads = static_cast<unsigned int>(std::stoul(argv[++i]));
+      } else {
+        print_usage(argv[0]);
+        return 1;
+      }
+    }
+  } catch (const std::exception& e) {
+    std::cerr << e.what() << "\n";
+    return 1;
+  }
+
+  const ModelParams& p = opts.model;
+  std::cout << "Generating " << p.describe() << "...\n";
+  Fixture f = make_fixture(p);
+  std::cout << "Model: " << p.voxels() << " voxels, " << f.text.size() << " bytes of input, " << f.blocks.size()
+            << " greedy blocks (" << static_cast<double>(p.voxels()) / f.blocks.size() << " voxels/block)\n"
+            << "Row kernels: " << row_kernels_isa() << ", threads: " << opts.threads << "\n";
+  print_header();
+
+  try {
+    run_benchmark(opts, "BM_Parse", [&] { return bench_parse(p, f); });
+    run_benchmark(opts, "BM_Growth/greedy", [&] { return bench_growth(p, f, GrowthStrategy::Greedy); });
+    run_benchmark(opts, "BM_Growth/largest", [&] { return bench_growth(p, f, GrowthStrategy::LargestBox); });
+    run_benchmark(opts, "BM_Growth/scanline", [&] { return bench_growth(p, f, GrowthStrategy::Scanline); });
+    run_benchmark(opts, "BM_Growth/octree", [&] { return bench_growth(p, f, GrowthStrategy::Octree); });
+
+    LabelTable labels(f.tag_table);
+    TextBlockBuffer text(labels);
+    BinaryBlockBuffer binary;
+    run_benchmark(opts, "BM_Output/text", [&] { return bench_output(p, f, text); });
+    run_benchmark(opts, "BM_Output/binary", [&] { return bench_output(p, f, binary); });
+
+    run_benchmark(opts, "BM_EndToEnd/threads:1", [&] { return bench_end_to_end(p, f, 1); });
+    if (opts.threads > 1) {
+      string name = "BM_EndToEnd/threads:" + std::to_string(opts.threads);
+      run_benchmark(opts, name, [&] { return bench_end_to_end(p, f, opts.threads); });
+    }
+  } catch (const std::exception& e) {
+    std::cerr << e.what() << "\n";
+    return 1;
+  }
+  return 0;
+}
@@ -0,0 +1,33 @@
+#include "model_generator.h"
+#include <iostream>
+#include <stdexcept>
+#include <string>
+
+// Writes a synthetic model in the input format to stdout, e.g.
+//   generate_model --size 1024,1024,256 --parent 8,8,8 --tags 6 > model.txt
+static void print_usage(const char* prog) {
+  std::cerr << "Usage: " << prog
+            << " [--size X,Y,Z] [--parent X,Y,Z] [--tags N] [--noise F] [--blobs N] [--blob-size N]"
+               " [--seed N]\n";
+}
+
+int main(int argc, char* argv[]) {
+  std::ios::sync_with_stdio(false);
+
+  ModelParams params;
+  try {
+    for (int i = 1; i < argc; ++i) {
+      if (!parse_model_option(argc, argv, i, params)) {
+        print_usage(argv[0]);
+        return 1;
+      }
+    }
+  } catch (const std::exception& e) {
+    std::cerr << e.what() << "\n";
+    return 1;
+  }
+
+  ModelGenerator generator(params);
+  generator.write(std::cout);
+  return 0;
+}
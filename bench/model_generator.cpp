@@ -0,0 +1,162 @@
+#include "model_generator.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <sstream>
+#include <stdexcept>
+
+using std::string;
+
+namespace {
+
+// Tag bytes in the order they are handed out; all are valid in the input format
+const char TAG_ALPHABET[] = "oabcdefghijklmnpqrstuvwxyzABCDEFGHIJKLMNOPQRSTUVWXYZ0123456789";
+const int MAX_TAGS = static_cast<int>(sizeof(TAG_ALPHABET) - 1);
+
+// splitmix64: tiny, fast and fully specified, unlike the <random>
+// distributions, whose output differs between standard libraries
+std::uint64_t splitmix64(std::uint64_t& state) {
+    std::uint64_t z = (state += 0x9E3779B97F4A7C15ull);
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+    return z ^ (z >> 31);
+}
+
+std::vector<int> split_ints(const string& value) {
+    std::vector<int> out;
+    std::stringstream ss(value);
+    string item;
+    while (std::getline(ss, item, ',')) out.push_back(std::stoi(item));
+    return out;
+}
+
+void parse_triple(const string& value, int& x, int& y, int& z) {
+    std::vector<int> v = split_ints(value);
+    if (v.size() != 3 || v[0] <= 0 || v[1] <= 0 || v[2] <= 0)
+        throw std::runtime_error("Expected three positive integers X,Y,Z, got '" + value + "'");
+    x = v[0];
+    y = v[1];
+    z = v[2];
+}
+
+} // namespace
+
+string ModelParams::describe() const {
+    std::ostringstream out;
+    out << x_count << "x" << y_count << "x" << z_count << " (parent " << parent_x << "x" << parent_y << "x"
+        << parent_z << ", " << tag_count << " tags, noise " << noise << ", " << blobs << " blobs up to "
+        << blob_size << ", seed " << seed << ")";
+    return out.str();
+}
+
+bool parse_model_option(int argc, char* argv[], int& i, ModelParams& params) {
+    string arg = argv[i];
+    if (arg != "--size" && arg != "--parent" && arg != "--tags" && arg != "--noise" && arg != "--blobs" &&
+        arg != "--blob-size" && arg != "--seed")
+        return false;
+    if (i + 1 >= argc) throw std::runtime_error("Missing value for " + arg);
+    string value = argv[++i];
+
+    try {
+        if (arg == "--size") {
+            parse_triple(value, params.x_count, params.y_count, params.z_count);
+        } else if (arg == "--parent") {
+            parse_triple(value, params.parent_x, params.parent_y, params.parent_z);
+        } else if (arg == "--tags") {
+            params.tag_count = std::stoi(value);
+            if (params.tag_count < 1 || params.tag_count > MAX_TAGS)
+                throw std::runtime_error("--tags must be between 1 and " + std::to_string(MAX_TAGS));
+        } else if (arg == "--noise") {
+            params.noise = std::stod(value);
+            if (params.noise < 0.0 || params.noise > 1.0) throw std::runtime_error("--noise must be in [0, 1]");
+        } else if (arg == "--blobs") {
+            params.blobs = std::stoi(value);
+            if (params.blobs < 0) throw std::runtime_error("--blobs must not be negative");
+        } else if (arg == "--blob-size") {
+            params.blob_size = std::stoi(value);
+            if (params.blob_size < 1) throw std::runtime_error("--blob-size must be positive");
+        } else {
+            params.seed = std::stoull(value);
+        }
+    } catch (const std::logic_error&) {
+        // std::stoi and friends throw invalid_argument / out_of_range
+        throw std::runtime_error("Invalid value for " + arg + ": '" + value + "'");
+    }
+    return true;
+}
+
+ModelGenerator::ModelGenerator(const ModelParams& params)
+    : p(params), tag_bytes(TAG_ALPHABET, TAG_ALPHABET + std::min(params.tag_count, MAX_TAGS)), state(params.seed) {
+    // Blobs are drawn from their own stream so the noise pattern does not
+    // depend on the blob count
+    std::uint64_t blob_state = p.seed ^ 0xB10B5EEDull;
+    auto unit = [&] { return static_cast<double>(splitmix64(blob_state) >> 11) * 0x1.0p-53; };
+    if (tag_bytes.size() > 1) {
+        for (int i = 0; i < p.blobs; ++i) {
+            Blob b;
+            b.cx = unit() * p.x_count;
+            b.cy = unit() * p.y_count;
+            b.cz = unit() * p.z_count;
+            b.rx = 0.5 + unit() * p.blob_size / 2.0;
+            b.ry = 0.5 + unit() * p.blob_size / 2.0;
+            b.rz = 0.5 + unit() * p.blob_size / 2.0;
+            b.tag = tag_bytes[1 + splitmix64(blob_state) % (tag_bytes.size() - 1)];
+            blob_list.push_back(b);
+        }
+    }
+}
+
+std::uint64_t ModelGenerator::next_random() {
+    return splitmix64(state);
+}
+
+double ModelGenerator::next_unit() {
+    return static_cast<double>(next_random() >> 11) * 0x1.0p-53;
+}
+
+void ModelGenerator::next_slice(std::vector<char>& plane) {
+    if (z >= p.z_count) throw std::runtime_error("ModelGenerator: no slices left");
+    plane.assign(static_cast<std::size_t>(p.y_count) * p.x_count, tag_bytes[0]);
+
+    // Later blobs paint over earlier ones. Cell centres inside the ellipsoid
+    // take its tag, which leaves a contiguous span per row.
+    double zc = z + 0.5;
+    for (const Blob& b : blob_list) {
+        double fz = 1.0 - ((zc - b.cz) / b.rz) * ((zc - b.cz) / b.rz);
+        if (fz <= 0.0) continue;
+        int y0 = std::max(0, static_cast<int>(std::floor(b.cy - b.ry)));
+        int y1 = std::min(p.y_count, static_cast<int>(std::ceil(b.cy + b.ry)));
+        for (int y = y0; y < y1; ++y) {
+            double dy = (y + 0.5 - b.cy) / b.ry;
+            double f = fz - dy * dy;
+            if (f <= 0.0) continue;
+            double half = b.rx * std::sqrt(f);
+            int x0 = std::max(0, static_cast<int>(std::ceil(b.cx - half - 0.5)));
+            int x1 = std::min(p.x_count, static_cast<int>(std::floor(b.cx + half - 0.5)) + 1);
+            if (x0 < x1) std::memset(&plane[static_cast<std::size_t>(y) * p.x_count + x0], b.tag, x1 - x0);
+        }
+    }
+
+    if (p.noise > 0.0) {
+        for (char& cell : plane)
+            if (next_unit() < p.noise) cell = tag_bytes[next_random() % tag_bytes.size()];
+    }
+    ++z;
+}
+
+void ModelGenerator::write(std::ostream& out) {
+    out << p.x_count << "," << p.y_count << "," << p.z_count << "," << p.parent_x << "," << p.parent_y << ","
+        << p.parent_z << "\n";
+    for (char tag : tag_bytes) out << tag << ", label_" << tag << "\n";
+    out << "\n";
+
+    std::vector<char> plane;
+    while (z < p.z_count) {
+        next_slice(plane);
+        for (int y = 0; y < p.y_count; ++y) {
+            out.write(&plane[static_cast<std::size_t>(y) * p.x_count], p.x_count);
+            out.put('\n');
+        }
+        out.put('\n');
+    }
+}
@@ -0,0 +1,74 @@
+#ifndef MODEL_GENERATOR_H
+#define MODEL_GENERATOR_H
+
+#include <cstdint>
+#include <ostream>
+#include <string>
+#include <vector>
+
+// Parameters of a synthetic block model. The same parameters (and seed)
+// always produce the same model, on every platform.
+struct ModelParams {
+    int x_count = 256, y_count = 256, z_count = 64;
+    int parent_x = 8, parent_y = 8, parent_z = 8;
+    int tag_count = 4;      // tag 0 is the background
+    double noise = 0.01;    // fraction of cells replaced by a random tag
+    int blobs = 64;         // ellipsoids painted over the background
+    int blob_size = 24;     // largest blob diameter along any axis
+    std::uint64_t seed = 1;
+
+    std::uint64_t voxels() const {
+        return static_cast<std::uint64_t>(x_count) * y_count * z_count;
+    }
+
+    // "256x256x64 (parent 8x8x8, 4 tags, noise 0.01, 64 blobs up to 24, seed 1)"
+    std::string describe() const;
+};
+
+// Parses one generator option (--size X,Y,Z, --parent X,Y,Z, --tags N,
+// --noise F, --blobs N, --blob-size N, --seed N) at argv[i], advancing i past
+// its value. Returns false if argv[i] is not a generator option; throws
+// std::runtime_error if its value is invalid.
+bool parse_model_option(int argc, char* argv[], int& i, ModelParams& params);
+
+// Deterministic synthetic model: a background tag with blobs of the other
+// tags and uniform noise on top. Slices are produced one at a time, so models
+// far larger than memory can be written out.
+class ModelGenerator {
+public:
+    explicit ModelGenerator(const ModelParams& params);
+
+    const ModelParams& params() const {
+        return p;
+    }
+
+    // Tag bytes, background first
+    const std::vector<char>& tags() const {
+        return tag_bytes;
+    }
+
+    // Fills plane ([y_count][x_count]) with the next slice, starting from z = 0
+    void next_slice(std::vector<char>& plane);
+
+    // Writes the model in the input format: spec, tag table, then every slice
+    // not yet produced (the whole model on a fresh generator)
+    void write(std::ostream& out);
+
+private:
+    struct Blob {
+        double cx, cy, cz; // centre
+        double rx, ry, rz; // radii
+        char tag;
+    };
+
+    ModelParams p;
+    std::vector<char> tag_bytes;
+    std::vector<Blob> blob_list;
+    std::uint64_t state; // noise stream, advanced in slice order
+    int z = 0;
+
+    std::uint64_t next_random();
+    double next_unit(); // uniform in [0, 1)
+};
+
+#endif // MODEL_GENERATOR_H
@@ -0,0 +1,86 @@
+#ifndef BINARY_FORMAT_H
+#define BINARY_FORMAT_H
+
+#include "block.h"
+#include "block_sink.h"
+#include <cstddef>
+#include <cstdint>
+#include <istream>
+#include <ostream>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+// Compact binary alternative to the text output. All integers are LEB128
+// varints; signed ones are zigzag-encoded first.
+//
+//   header:  "BLKC", version byte (1), x_count, y_count, z_count,
+//            parent_x, parent_y, parent_z, tag count, then per tag
+//            (ascending tag byte): tag byte, label length, label bytes
+//   chunks:  block count, then per block: zigzag dx, dy, dz, width,
+//            height, depth, tag byte
+//
+// dx/dy/dz are taken against the previous block of the same chunk (the first
+// block of a chunk against 0,0,0). Each buffered parent block or slab becomes
+// one chunk, so chunks can be encoded independently. Chunks run to the end of
+// the stream.
+
+struct BinaryHeader {
+    int x_count = 0, y_count = 0, z_count = 0;
+    int parent_x = 0, parent_y = 0, parent_z = 0;
+    std::vector<std::pair<char, std::string>> tags; // ascending tag byte
+
+    BinaryHeader() = default;
+    BinaryHeader(const std::vector<int>& spec, const std::unordered_map<char, std::string>& tag_table);
+
+    std::unordered_map<char, std::string> tag_table() const;
+};
+
+void write_binary_header(std::ostream& out, const BinaryHeader& header);
+
+// Encodes blocks as one chunk of binary records
+class BinaryBlockBuffer : public BlockBuffer {
+public:
+    BinaryBlockBuffer();
+
+    void emit(const Block& b) override;
+    void write_to(std::ostream& out) override;
+    void clear() override;
+
+private:
+    std::vector<std::uint8_t> buf;
+    std::size_t len = 0;
+    std::uint32_t blocks = 0;
+    int prev_x = 0, prev_y = 0, prev_z = 0;
+};
+
+// Reads a binary stream back. The constructor reads and checks the header;
+// next() then returns the blocks in order. Throws std::runtime_error on a
+// bad header or a truncated record.
+class BinaryBlockReader {
+public:
+    explicit BinaryBlockReader(std::istream& in);
+
+    const BinaryHeader& header() const {
+        return hdr;
+    }
+
+    // Stores the next block in b; false at the end of the stream
+    bool next(Block& b);
+
+private:
+    std::streambuf* src;
+    BinaryHeader hdr;
+    std::uint32_t chunk_left = 0;
+    int prev_x = 0, prev_y = 0, prev_z = 0;
+
+    int read_byte();
+    std::uint32_t read_varint();
+    int read_int();
+};
+
+// Converts a binary stream to the text format, line for line
+void binary_to_text(std::istream& in, std::ostream& out);
+
+#endif // BINARY_FORMAT_H
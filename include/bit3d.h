@@ -0,0 +1,122 @@
+#ifndef BIT3D_H
+#define BIT3D_H
+
+#include <cstdint>
+#include <vector>
+
+// Bit-packed 3D bitmap: [depth][height][width], one bit per cell. Every row
+// starts on a 64-bit word boundary so row ranges map onto whole-word masks.
+class Bit3D {
+public:
+    int depth, height, width;
+    int words_per_row;
+    std::vector<std::uint64_t> words;
+
+    Bit3D() : depth(0), height(0), width(0), words_per_row(0) {}
+    Bit3D(int d, int h, int w)
+        : depth(d), height(h), width(w), words_per_row((w + 63) / 64),
+          words(static_cast<std::size_t>(d) * h * ((w + 63) / 64), 0) {}
+
+    // Clears every bit, reshaping the bitmap if needed (storage is reused)
+    void reset(int d, int h, int w) {
+        depth = d;
+        height = h;
+        width = w;
+        words_per_row = (w + 63) / 64;
+        words.assign(static_cast<std::size_t>(d) * h * words_per_row, 0);
+    }
+
+    inline bool test(int z, int y, int x) const {
+        return (row(z, y)[x >> 6] >> (x & 63)) & 1u;
+    }
+
+    inline void set(int z, int y, int x) {
+        row(z, y)[x >> 6] |= std::uint64_t{1} << (x & 63);
+    }
+
+    // True if any bit in [x0,x1) of row (z,y) is set
+    bool row_any(int z, int y, int x0, int x1) const {
+        const std::uint64_t* r = row(z, y);
+        int w0 = x0 >> 6, w1 = (x1 - 1) >> 6;
+        if (w0 == w1) return (r[w0] & range_mask(x0 & 63, ((x1 - 1) & 63) + 1)) != 0;
+
+        if (r[w0] & range_mask(x0 & 63, 64)) return true;
+        for (int w = w0 + 1; w < w1; ++w)
+            if (r[w]) return true;
+        return (r[w1] & range_mask(0, ((x1 - 1) & 63) + 1)) != 0;
+    }
+
+    // Sets every bit in [x0,x1) of row (z,y)
+    void row_set(int z, int y, int x0, int x1) {
+        std::uint64_t* r = row(z, y);
+        int w0 = x0 >> 6, w1 = (x1 - 1) >> 6;
+        if (w0 == w1) {
+            r[w0] |= range_mask(x0 & 63, ((x1 - 1) & 63) + 1);
+            return;
+        }
+
+        r[w0] |= range_mask(x0 & 63, 64);
+        for (int w = w0 + 1; w < w1; ++w)
+            r[w] = ~std::uint64_t{0};
+        r[w1] |= range_mask(0, ((x1 - 1) & 63) + 1);
+    }
+
+    // Number of set bits in [x0,x1) of row (z,y)
+    int row_count(int z, int y, int x0, int x1) const {
+        const std::uint64_t* r = row(z, y);
+        int w0 = x0 >> 6, w1 = (x1 - 1) >> 6;
+        if (w0 == w1) return __builtin_popcountll(r[w0] & range_mask(x0 & 63, ((x1 - 1) & 63) + 1));
+
+        int count = __builtin_popcountll(r[w0] & range_mask(x0 & 63, 64));
+        for (int w = w0 + 1; w < w1; ++w)
+            count += __builtin_popcountll(r[w]);
+        return count + __builtin_popcountll(r[w1] & range_mask(0, ((x1 - 1) & 63) + 1));
+    }
+
+    // First set bit in [x0,x1) of row (z,y), or x1 if there is none
+    int row_find_set(int z, int y, int x0, int x1) const {
+        const std::uint64_t* r = row(z, y);
+        int w1 = (x1 - 1) >> 6;
+        for (int w = x0 >> 6; w <= w1; ++w) {
+            std::uint64_t bits = r[w];
+            if (w == (x0 >> 6)) bits &= range_mask(x0 & 63, 64);
+            if (bits) {
+                int x = (w << 6) + __builtin_ctzll(bits);
+                return x < x1 ? x : x1;
+            }
+        }
+        return x1;
+    }
+
+    // True if any bit in the window [z0,z1) x [y0,y1) x [x0,x1) is set
+    bool any(int z0, int z1, int y0, int y1, int x0, int x1) const {
+        for (int z = z0; z < z1; ++z)
+            for (int y = y0; y < y1; ++y)
+                if (row_any(z, y, x0, x1)) return true;
+        return false;
+    }
+
+    // Sets every bit in the window [z0,z1) x [y0,y1) x [x0,x1)
+    void set_window(int z0, int z1, int y0, int y1, int x0, int x1) {
+        for (int z = z0; z < z1; ++z)
+            for (int y = y0; y < y1; ++y)
+                row_set(z, y, x0, x1);
+    }
+
+private:
+    // Bits [lo, hi) of a word, 0 <= lo < hi <= 64
+    static inline std::uint64_t range_mask(int lo, int hi) {
+        std::uint64_t upper = hi == 64 ? ~std::uint64_t{0} : (std::uint64_t{1} << hi) - 1;
+        return upper & (~std::uint64_t{0} << lo);
+    }
+
+    inline std::uint64_t* row(int z, int y) {
+        return &words[(static_cast<std::size_t>(z) * height + y) * words_per_row];
+    }
+
+    inline const std::uint64_t* row(int z, int y) const {
+        return &words[(static_cast<std::size_t>(z) * height + y) * words_per_row];
+    }
+};
+
+#endif // BIT3D_H
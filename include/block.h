@@ -1,8 +1,6 @@
 #ifndef BLOCK_H
 #define BLOCK_H
 
-#include <string>
-
 // Represents an axis-aligned rectangular prism ("block") in the model.
 // Coordinates (x,y,z) are absolute in the global grid.
 // Offsets (x_offset,y_offset,z_offset) are indices within the local sub-volume
@@ -18,8 +16,8 @@ public:
   // Size (dimensions) of the block
   int width, height, depth;
 
-  // Volume of the block
-  int volume;
+  // Volume of the block; 64-bit, as a merged block can cover the whole model
+  long long volume;
 
   // Absolute end coordinates (exclusive)
   int x_end, y_end, z_end;
@@ -36,11 +34,6 @@ public:
   void set_width(int w);
   void set_height(int h);
   void set_depth(int d);
-
-  // Print in the exact Python format:
-  //   x,y,z,width,height,depth,label
-  // (label is looked up by BlockGrowth and passed in here)
-  void print_block(const std::string& label) const;
 };
 
 #endif // BLOCK_H
\ No newline at end of file
@@ -0,0 +1,94 @@
+#ifndef BLOCK_COMPRESSOR_H
+#define BLOCK_COMPRESSOR_H
+
+#include "block.h"
+#include "block_growth.h"
+#include "block_merger.h"
+#include "block_sink.h"
+#include "flat3d.h"
+#include "slab_parents.h"
+#include "thread_pool.h"
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// In-memory compression for embedding: the caller pushes the model's tags
+// and receives blocks through a BlockSink (a BlockList, a CallbackSink or a
+// formatting buffer), with no stdin/stdout involved. Blocks arrive in the
+// same order, with the same content, as BlockModel writes them.
+//
+// Slices can be pushed any number at a time. Whole slabs (parent_z slices)
+// pushed on a slab boundary are compressed in place; anything else is
+// gathered into an internal slab buffer first.
+//
+//     BlockList blocks;
+//     BlockCompressor compressor(spec, tag_table, blocks);
+//     compressor.push_slices(voxels, spec.z_count);
+//     compressor.finish();
+class BlockCompressor {
+public:
+    // Throws std::runtime_error if a dimension is not positive
+    BlockCompressor(const ModelSpec& spec, const std::unordered_map<char, std::string>& tag_table, BlockSink& out);
+
+    // Settings apply from the next slab on
+    void set_num_threads(unsigned int threads);
+    void set_growth_strategy(GrowthStrategy strategy);
+    void set_merge_mode(MergeMode mode); // only before the first push
+
+    const ModelSpec& spec() const {
+        return model_spec;
+    }
+
+    // Labels of the tag table, for formatting the emitted blocks
+    const LabelTable& labels() const {
+        return label_table;
+    }
+
+    int slices_pushed() const {
+        return next_slice;
+    }
+
+    // Pushes n_slices slices following the ones already pushed. slices holds
+    // n_slices x y_count x x_count tags in z, y, x order. Blocks of every slab
+    // completed by the push are emitted before it returns. Throws
+    // std::runtime_error if this would go past z_count slices.
+    void push_slices(const char* slices, int n_slices);
+
+    // Emits whatever is still held back (a merge pass) once every slice has
+    // been pushed. Throws std::runtime_error if slices are missing.
+    void finish();
+
+private:
+    ModelSpec model_spec;
+    LabelTable label_table;
+    BlockSink& out;
+
+    GrowthStrategy growth_strategy = GrowthStrategy::Greedy;
+    MergeMode merge_mode = MergeMode::None;
+    unsigned int num_threads = 1;
+    std::unique_ptr<ThreadPool> pool; // created on first use when num_threads > 1
+
+    int next_slice = 0;      // slices pushed so far
+    Flat3D<char> pending;    // partial slab, [parent_z][y_count][x_count]
+    int pending_slices = 0;
+
+    SlabParents parents;         // parent blocks of the current slab, (y, x) order
+    std::vector<BlockList> lists; // per run of parent blocks when compressing in parallel
+    TaskGroup tasks;
+
+    std::unique_ptr<BlockMerger> merger;
+    BlockList slab_blocks; // blocks of the current slab, when merging
+    bool finished = false;
+
+    int slab_slices(int top_slice) const;
+    void compress_slab(const Flat3DView<const char>& slab, int top_slice);
+};
+
+// Compresses a whole model held in memory (z_count x y_count x x_count tags
+// in z, y, x order) and returns its blocks in output order
+std::vector<Block> compress_model(const ModelSpec& spec, const std::unordered_map<char, std::string>& tag_table,
+                                  const char* voxels, GrowthStrategy strategy = GrowthStrategy::Greedy,
+                                  unsigned int threads = 1);
+
+#endif // BLOCK_COMPRESSOR_H
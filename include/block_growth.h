@@ -1,57 +1,105 @@
 #ifndef BLOCK_GROWTH_H
 #define BLOCK_GROWTH_H
 
+#include "bit3d.h"
 #include "block.h"
-#include <string>
-#include <unordered_map>
+#include "block_sink.h"
+#include "flat3d.h"
+#include "summed_volume_table.h"
+#include <memory>
 #include <vector>
 
-// Flattened 3D container: [depth][height][width]
-template <typename T>
-class Flat3D {
-public:
-    int depth, height, width;
-    std::vector<T> data;
-
-    Flat3D() : depth(0), height(0), width(0) {}
-    Flat3D(int d, int h, int w, T init = T()) : depth(d), height(h), width(w), data(d * h * w, init) {}
-
-    inline T& at(int z, int y, int x) {
-        return data[(z * height + y) * width + x];
-    }
+// How a parent block is split into emitted blocks. Greedy and LargestBox fit
+// the largest cube of the most common tag and grow it; the others trade
+// compression ratio for throughput. All of them emit blocks that tile the
+// parent block exactly.
+enum class GrowthStrategy {
+    Greedy,     // cube grown +Z, then +Y, then +X one layer at a time (reference output)
+    LargestBox, // cube grown to the largest box of its tag anchored at its origin
+    Scanline,   // row runs merged into rectangles per slice, then extruded along z
+    Octree      // parent split into octants until each part is one tag
+};
 
-    inline const T& at(int z, int y, int x) const {
-        return data[(z * height + y) * width + x];
-    }
+// Working buffers for BlockGrowth. Keeping one per thread and passing it to
+// each BlockGrowth lets consecutive parent blocks reuse the mask, tables and
+// caches instead of reallocating them.
+struct GrowthScratch {
+    Bit3D compressed;
+    std::vector<SummedVolumeTable> tag_sums;
+    std::vector<int> fit_cursor;
+    std::vector<std::vector<int>> fit_cache;
+    std::vector<int> runs;
+    std::vector<Block> rows, next_rows, rects, boxes, next_boxes; // Scanline
 };
 
 // BlockGrowth encapsulates the "fit & grow" compression logic for a parent block
-// over a sub-volume (model_slices). The tag_table maps single-char tags to labels.
+// over a sub-volume (model_slices). Emitted blocks go to a BlockSink, which
+// resolves their labels.
+// model_slices is a view, so it can point straight into a larger buffer; it and
+// scratch (if given) must outlive the BlockGrowth.
 class BlockGrowth {
 public:
-    BlockGrowth(const Flat3D<char>& model_slices, const std::unordered_map<char, std::string>& tag_table);
+    BlockGrowth(const Flat3DView<const char>& model_slices, GrowthStrategy strategy = GrowthStrategy::Greedy,
+                GrowthScratch* scratch = nullptr);
 
-    void run(Block parent_block);
+    // Compresses parent_block and passes each emitted block to out
+    void run(Block parent_block, BlockSink& out);
 
 private:
-    const Flat3D<char>& model;
-    const std::unordered_map<char, std::string>& tag_table;
+    Flat3DView<const char> model;
+    GrowthStrategy strategy;
+
+    std::unique_ptr<GrowthScratch> owned_scratch; // only when none is passed in
+    GrowthScratch& scratch;
 
     Block parent_block{0, 0, 0, 0, 0, 0, '\0'};
     int parent_x_end = 0, parent_y_end = 0, parent_z_end = 0;
 
-    // Tracks which cells in 'model' have been compressed (0 = false, 1 = true)
-    Flat3D<char> compressed;
+    // Tracks which cells in 'model' have been compressed (bit set = true).
+    // Window checks and marking work on whole 64-bit words per row.
+    Bit3D& compressed;
+
+    // Tags present in 'model' get dense slots 0..tag_count-1 in byte order
+    // (tag_slot is -1 for absent bytes, slot_tag maps back), so per-tag state
+    // is indexed by slot and a lower slot is a lower tag byte.
+    // Summed-volume tables, one per slot (built once in the constructor),
+    // make the tag purity check of a window constant time. Only the first
+    // tag_count entries of tag_sums belong to this model; the rest is spare
+    // storage.
+    std::vector<SummedVolumeTable>& tag_sums;
+    int tag_slot[256];
+    char slot_tag[256];
+    int tag_count = 0;
+
+    // Uncompressed cells left in the parent block, in total and per slot
+    int remaining = 0;
+    int remaining_by_slot[256] = {0};
+
+    // Per tag slot: index (z, y, x order within the parent) of the first cell
+    // that may still start a cube, and an upper bound on the largest feasible
+    // cube at every origin (filled on the tag's first fit)
+    std::vector<int>& fit_cursor;
+    std::vector<std::vector<int>>& fit_cache;
 
     bool all_compressed() const;
-    char get_mode_of_uncompressed(const Block& blk) const;
+    char get_mode_of_uncompressed() const;
 
-    Block fit_block(char mode, int width, int height, int depth);
-    void grow_block(Block& current, Block& best_block);
+    Block fit_block(char mode, int cube_size);
+    void grow_block(Block& b);
+    void grow_largest_box(Block& b);
+
+    void run_scanline(BlockSink& out);
+    void run_octree(int z0, int z1, int y0, int y1, int x0, int x1, BlockSink& out);
 
     bool window_is_all(char val, int z0, int z1, int y0, int y1, int x0, int x1) const;
     bool window_is_all_uncompressed(int z0, int z1, int y0, int y1, int x0, int x1) const;
-    void mark_compressed(int z0, int z1, int y0, int y1, int x0, int x1, char v);
+    void mark_compressed(char tag, int z0, int z1, int y0, int y1, int x0, int x1);
 };
 
+// Compresses one parent block of model with the given strategy. Greedy goes
+// to FixedGrowth when the parent block has one of its compiled-in sizes;
+// otherwise a BlockGrowth runs with this thread's GrowthScratch.
+void grow_parent_block(const Flat3DView<const char>& model, const Block& parent, GrowthStrategy strategy,
+                       BlockSink& out);
+
 #endif  // BLOCK_GROWTH_H
@@ -0,0 +1,57 @@
+#ifndef BLOCK_MERGER_H
+#define BLOCK_MERGER_H
+
+#include "block.h"
+#include "block_sink.h"
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+
+// Optional post-pass joining compressed blocks across parent block borders.
+// Merged blocks no longer lie inside a single parent block, so it is only for
+// consumers that do not need that guarantee.
+enum class MergeMode {
+    None, // blocks are written as compressed (reference output)
+    Z,    // join blocks with the same x/y extent and tag across slabs
+    XYZ   // also join neighbours in x and y within a slab first
+};
+
+// Streams slabs of blocks through the merge, in slab order. Only the blocks
+// touching the bottom face of the previous slab (the frontier) are held back,
+// so memory is bounded by one slab. Every other block goes to out as soon as
+// its slab is added.
+class BlockMerger {
+public:
+    BlockMerger(MergeMode mode, BlockSink& out);
+
+    // Merges the blocks of the next slab, which ends before slice end_slice.
+    // blocks is reordered in place.
+    void add_slab(std::vector<Block>& blocks, int end_slice);
+
+    // Emits the blocks still held in the frontier
+    void finish();
+
+private:
+    MergeMode mode;
+    BlockSink& out;
+
+    // Blocks reaching the end of the previous slab, keyed by their (x, y)
+    std::vector<Block> frontier;
+    std::vector<char> continued;
+    std::unordered_map<std::uint64_t, std::size_t> frontier_at;
+    int frontier_end = -1;
+
+    std::vector<Block> next_frontier;
+
+    static std::uint64_t key(const Block& b) {
+        return (static_cast<std::uint64_t>(static_cast<std::uint32_t>(b.y)) << 32) |
+               static_cast<std::uint32_t>(b.x);
+    }
+
+    // Index of the frontier block b continues, or -1
+    long find_continued(const Block& b) const;
+
+    static bool merge_xy(std::vector<Block>& blocks);
+};
+
+#endif // BLOCK_MERGER_H
@@ -1,17 +1,33 @@
 #ifndef BLOCK_MODEL_H
 #define BLOCK_MODEL_H
 
+#include <chrono>
+#include <deque>
+#include <fstream>
+#include <iostream>
+#include <memory>
 #include <string>
 #include <unordered_map>
 #include <thread>
 #include <vector>
-#include <future>
-#include <mutex>
 #include "block.h"
 #include "block_growth.h"
+#include "block_merger.h"
+#include "block_sink.h"
+#include "checkpoint.h"
+#include "line_reader.h"
+#include "mapped_file.h"
+#include "packed_slab.h"
+#include "rle_slab.h"
+#include "slab_parents.h"
+#include "stats.h"
+#include "thread_pool.h"
 
-// BlockModel reads the spec, tag table, and 3D model from stdin,
-// batches slices by parent block thickness, and invokes BlockGrowth.
+// BlockModel reads the spec, tag table, and 3D model from stdin (or a
+// memory-mapped file), batches slices by parent block thickness, and invokes
+// BlockGrowth. With more than one thread, reading, compressing and writing
+// run as a pipeline over a small pool of slab buffers, and the parent blocks
+// of every slab in flight are balanced across the pool's threads.
 class BlockModel {
 public:
     BlockModel(); // Constructor to initialize threading
@@ -19,33 +35,139 @@ public:
     void read_tag_table();     // reads "tag, label" lines until an empty line
     void read_model();         // reads z_count slices, each: y_count rows of x_count chars (then blank line)
     void set_num_threads(unsigned int threads); // Set number of threads to use
+    void set_growth_strategy(GrowthStrategy strategy); // How fitted cubes are grown
+    void set_input_file(const std::string& path); // Read from a memory-mapped file instead of stdin
+    void set_output_format(OutputFormat format);  // Text lines (default) or binary records
+    void set_slab_encoding(SlabEncoding encoding); // Keep copied slabs dense (default), run-length encoded or packed
+    void set_merge_mode(MergeMode mode);           // Join blocks across parent block borders before output
+    void set_collect_stats(bool enabled);          // JSON statistics report on stderr after read_model
+    void set_output_file(const std::string& path); // Write to a file instead of stdout
+    void set_checkpoint(const std::string& path, int every_slabs); // Save progress every N slabs (needs files)
+    void set_resume(bool enabled);                 // Continue from the checkpoint instead of starting over
 
 private:
     int x_count = 0, y_count = 0, z_count = 0;
     int parent_x = 0, parent_y = 0, parent_z = 0;
 
-    // Ring buffer for slices: [parent_z][y_count][x_count]
-    Flat3D<char> model;
+    ModelSpec spec() const {
+        return {x_count, y_count, z_count, parent_x, parent_y, parent_z};
+    }
 
-    // Single-char tag -> label
+    // One slab (parent_z slices) on its way through read -> compress -> write
+    struct Slab {
+        Flat3D<char> rows;           // [parent_z][y_count][x_count] copy of the input
+        RleSlab runs;                // the same, run-length encoded, when encoding is Rle
+        PackedSlab packed;           // the same as packed tag ids, when encoding is Packed
+        SlabEncoding encoding = SlabEncoding::Dense;
+        Flat3DView<const char> view; // rows, or the slab inside the mapped file (unset if encoded)
+        int top_slice = 0, n_slices = 0;
+        std::size_t input_end = 0;   // input offset just past the slab
+
+        // Parent blocks with their uniform-tag summary, filled row by row
+        // while the slab is loaded
+        SlabParents parents;
+
+        // Encoded output, one buffer per run of parent blocks (only the first
+        // is used when compressing serially); storage is reused across slabs
+        std::vector<std::unique_ptr<BlockBuffer>> output;
+        std::vector<BlockList> lists; // used instead of output when merging
+        std::size_t n_output = 0;     // buffers filled for this slab
+
+        TaskGroup tasks; // the slab's parent blocks queued on the pool
+
+        // Filled only when collecting statistics; each parent block's task
+        // writes its own entry of parent_stats
+        SlabStats stats;
+        std::vector<ParentStats> parent_stats;
+    };
+
+    // Slab buffers in flight. The pipeline keeps at most this many slabs in
+    // memory: one being read, one being written and the rest compressing.
+    static const std::size_t PIPELINE_DEPTH = 4;
+    std::deque<Slab> slabs;
+
+    // Merge post-pass (only when merge_mode is set), fed by the writer in
+    // slab order
+    std::unique_ptr<BlockMerger> merger;
+    std::unique_ptr<BlockBuffer> merged_output;
+    std::vector<Block> merge_blocks;
+
+    // Single-char tag -> label, the same labels resolved per tag byte, and
+    // the tags' dense ids (used by packed slabs)
     std::unordered_map<char, std::string> tag_table;
+    LabelTable labels;
+    TagIds tag_ids;
 
-    // Threading support
-    mutable std::mutex output_mutex;
+    GrowthStrategy growth_strategy = GrowthStrategy::Greedy;
+    OutputFormat output_format = OutputFormat::Text;
+    SlabEncoding slab_encoding = SlabEncoding::Dense;
+    MergeMode merge_mode = MergeMode::None;
+
+    // --stats: per-slab figures gathered as slabs are written, reported at
+    // the end of read_model
+    bool collect_stats = false;
+    StatsReport stats;
+    std::chrono::steady_clock::time_point header_start;
+
+    // Where blocks are written: stdout, or output_file when a path is set
+    std::string output_path;
+    std::ofstream output_file;
+    std::ostream* out = &std::cout;
+
+    // --checkpoint: after every checkpoint_every slabs (and the last) the
+    // output is flushed and the checkpoint replaced. --resume reloads it,
+    // truncates the output to the checkpointed size, seeks the input and
+    // starts at first_slice.
+    std::string checkpoint_path;
+    int checkpoint_every = 1;
+    bool resume = false;
+    int first_slice = 0;
+
+    // Threading support: parent blocks are compressed as pool tasks (the pool
+    // is created lazily by read_model) and emitted in (y, x) order.
     unsigned int num_threads;
+    std::unique_ptr<ThreadPool> pool;
+
+    // Bulk reader over std::cin (or the mapped file), created on first use
+    std::unique_ptr<LineReader> reader;
+
+    // Mapped input file; when its rows are laid out uniformly, slabs are
+    // compressed straight from the mapping instead of the ring buffer
+    std::unique_ptr<MappedFile> mapped;
+    int mapped_eol = 0;           // 1 = LF, 2 = CRLF, 0 = copy rows instead
 
     // Helper functions
+    LineReader& input();
     static bool is_empty_line(const std::string& s);
-    static void getline_strict(std::string& out);
+    void getline_strict(std::string& out);
     static std::vector<int> split_csv_ints(const std::string& line);
 
-    static Flat3D<char> slice_model(const Flat3D<char>& src,
-                                    int depth, int y0, int y1, int x0, int x1);
+    // View of slices [0,depth) x rows [y0,y1) x columns [x0,x1) of a slab;
+    // BlockGrowth reads the parent block in place through it
+    static Flat3DView<const char> slice_model(const Flat3DView<const char>& src,
+                                              int depth, int y0, int y1, int x0, int x1);
 
-    void compress_slices(int top_slice, int n_slices);
-    void process_parent_block(int x, int y, int z, int width, int height, int depth, char tag, int n_slices);
-    std::string process_parent_block_to_string(int x, int y, int z, int width, int height, int depth, char tag, int n_slices);
-    std::string process_parent_block_to_string_safe(const Flat3D<char>& model_slices, const Block& parentBlock);
+    void load_slab(Slab& slab, int top_slice);
+    void read_slab_rows(Slab& slab, int top_slice);
+    Flat3DView<const char> read_slab(Slab& slab);
+    void read_slab_encoded(Slab& slab);
+    void read_slab_packed(Slab& slab);
+    void size_rows(Slab& slab); // shapes slab.rows for a dense copy of a slab
+    void detect_mapped_layout();
+    bool map_slab(int top_slice, int n_slices, Flat3DView<const char>& slab);
+    void compress_slices(Slab& slab);
+    void prepare_slab(Slab& slab);
+    void submit_slab(Slab& slab);
+    void compress_parent(Slab& slab, std::size_t i, BlockSink& out);
+    void grow_parent(const Slab& slab, std::size_t i, BlockSink& out);
+    BlockSink& parent_sink(Slab& slab, std::size_t i);
+    std::unique_ptr<BlockBuffer> make_block_buffer() const;
+    void write_slab_output(Slab& slab);
+    void write_slab_blocks(Slab& slab);
+    void record_slab_stats(Slab& slab);
+    void open_output();
+    void save_checkpoint(const Slab& slab);
+    void run_pipeline();
 };
 
 #endif // BLOCK_MODEL_H
\ No newline at end of file
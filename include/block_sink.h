@@ -0,0 +1,101 @@
+#ifndef BLOCK_SINK_H
+#define BLOCK_SINK_H
+
+#include "block.h"
+#include <cstddef>
+#include <functional>
+#include <ostream>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+// Destination for the blocks BlockGrowth emits, in emission order.
+class BlockSink {
+public:
+    virtual ~BlockSink() = default;
+    virtual void emit(const Block& b) = 0;
+};
+
+// How emitted blocks are written out
+enum class OutputFormat {
+    Text,  // x,y,z,width,height,depth,label lines (reference output)
+    Binary // header plus packed records, see binary_format.h
+};
+
+// Sink that keeps a run of blocks (a parent block or a whole slab) in memory
+// until its owner writes it out. clear() keeps the storage for reuse.
+class BlockBuffer : public BlockSink {
+public:
+    virtual void write_to(std::ostream& out) = 0;
+    virtual void clear() = 0;
+};
+
+// Sink that simply collects the blocks, e.g. for a post-pass over them
+class BlockList : public BlockSink {
+public:
+    std::vector<Block> blocks;
+
+    void emit(const Block& b) override {
+        blocks.push_back(b);
+    }
+};
+
+// Sink that hands each block to a caller-supplied function
+class CallbackSink : public BlockSink {
+public:
+    explicit CallbackSink(std::function<void(const Block&)> callback) : callback(std::move(callback)) {}
+
+    void emit(const Block& b) override {
+        callback(b);
+    }
+
+private:
+    std::function<void(const Block&)> callback;
+};
+
+// Labels resolved once per tag byte, so emitting a block is a plain array
+// index instead of a hash lookup. Tags missing from the tag table map to the
+// tag character itself.
+class LabelTable {
+public:
+    LabelTable();
+    explicit LabelTable(const std::unordered_map<char, std::string>& tag_table);
+
+    const std::string& operator[](char tag) const {
+        return labels[static_cast<unsigned char>(tag)];
+    }
+
+private:
+    std::string labels[256];
+};
+
+// Formats blocks as "x,y,z,width,height,depth,label\n" lines into a reusable
+// buffer with a hand-rolled integer formatter. The buffer starts empty and
+// grows to what its blocks need.
+class TextBlockBuffer : public BlockBuffer {
+public:
+    explicit TextBlockBuffer(const LabelTable& labels);
+
+    void emit(const Block& b) override;
+    void write_to(std::ostream& out) override;
+
+    const char* data() const {
+        return buf.data();
+    }
+
+    std::size_t size() const {
+        return len;
+    }
+
+    void clear() override {
+        len = 0;
+    }
+
+private:
+    const LabelTable* labels;
+    std::vector<char> buf;
+    std::size_t len = 0;
+};
+
+#endif // BLOCK_SINK_H
@@ -0,0 +1,126 @@
+#ifndef BLOCK_VALIDATOR_H
+#define BLOCK_VALIDATOR_H
+
+#include "bit3d.h"
+#include "block.h"
+#include "block_sink.h"
+#include "flat3d.h"
+#include "line_reader.h"
+#include "thread_pool.h"
+#include <cstdint>
+#include <deque>
+#include <istream>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+// Outcome of a validation run. Voxel counts are exact; errors holds the
+// first few problems found, for display.
+struct ValidationReport {
+    std::uint64_t blocks = 0;
+    std::uint64_t covered_voxels = 0;  // voxels covered at least once
+    std::uint64_t gap_voxels = 0;      // voxels no block covers
+    std::uint64_t overlap_voxels = 0;  // extra coverings of a voxel
+    std::uint64_t mismatch_voxels = 0; // covered with a label other than the model's
+    std::uint64_t bad_blocks = 0;      // malformed, out of bounds or unknown label
+    std::uint64_t parent_crossings = 0; // blocks not inside one parent block
+    std::vector<std::string> errors;
+
+    bool ok() const {
+        return gap_voxels == 0 && overlap_voxels == 0 && mismatch_voxels == 0 && bad_blocks == 0 &&
+               parent_crossings == 0;
+    }
+};
+
+// Checks a compressed block list (text or binary output) against the model
+// it was compressed from. The spec and tag table come from the model input
+// itself; model rows are read slab by slab as blocks reach them.
+//
+// Each open slab keeps its tags and a bit-packed coverage map. A slab is
+// closed as soon as every voxel in it is covered, and its tag checks then run
+// on the pool while later blocks are read. Blocks normally arrive slab by
+// slab, so only a slab or two is open at a time. Merged blocks reaching
+// further ahead keep more open, up to a limit; past it the oldest open slab is
+// closed early and its uncovered voxels count as gaps. Memory stays bounded
+// whatever the model size.
+class BlockValidator {
+public:
+    // Reads the spec and tag table from model. Throws std::runtime_error if
+    // they are malformed.
+    explicit BlockValidator(std::istream& model);
+
+    void set_num_threads(unsigned int threads);
+    void set_allow_parent_crossing(bool allow); // for --merge output
+    void set_max_open_slabs(std::size_t slabs);
+
+    // Validates the blocks in the compressor's output (text or binary,
+    // told apart by the binary magic). Call once.
+    ValidationReport validate(std::istream& blocks);
+
+private:
+    // The part of one block inside one slab, with its label id
+    struct Piece {
+        int x, y, z, width, height, depth; // z relative to the slab
+        int label;
+        std::uint64_t block;               // index of the block in the output
+    };
+
+    struct Slab {
+        int index = 0, top_slice = 0, n_slices = 0;
+        Flat3D<char> rows;
+        Bit3D covered;
+        std::uint64_t covered_count = 0;
+        std::vector<Piece> pieces;
+
+        std::uint64_t volume() const {
+            return static_cast<std::uint64_t>(n_slices) * rows.height * rows.width;
+        }
+    };
+
+    int x_count = 0, y_count = 0, z_count = 0;
+    int parent_x = 0, parent_y = 0, parent_z = 0;
+
+    // Labels are compared by id: every tag byte maps to the id of its label
+    // (the tag itself if it has none), and label_tag holds the tag of labels
+    // that only one tag byte has, or -1
+    std::vector<std::string> label_names;
+    std::unordered_map<std::string_view, int> label_ids;
+    int tag_label[256];
+    std::vector<int> label_tag;
+
+    LineReader model_in;
+    int slabs_read = 0;
+    int total_slabs = 0;
+
+    // Open slabs, consecutive from first_open; closed ones are null until
+    // the ones before them close too
+    std::deque<std::unique_ptr<Slab>> open;
+    int first_open = 0;
+
+    unsigned int num_threads = 1;
+    bool allow_parent_crossing = false;
+    std::size_t max_open_slabs = 64;
+    std::unique_ptr<ThreadPool> pool;
+    TaskGroup checks;
+    std::size_t checks_in_flight = 0;
+
+    std::mutex report_mtx; // guards report while checks run on the pool
+    ValidationReport report;
+    static const std::size_t MAX_ERRORS = 20;
+
+    void read_header();
+    int label_id(std::string_view label) const;
+    void error(const std::string& message); // keeps the first MAX_ERRORS messages
+
+    void add_block(const Block& b, int label, std::uint64_t index);
+    Slab& slab(int index);
+    void close_slab(int index);
+    void check_slab(Slab& slab);
+    void read_text_blocks(std::istream& in);
+    void read_binary_blocks(std::istream& in);
+};
+
+#endif // BLOCK_VALIDATOR_H
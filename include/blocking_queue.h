@@ -0,0 +1,48 @@
+#ifndef BLOCKING_QUEUE_H
+#define BLOCKING_QUEUE_H
+
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+
+// Unbounded FIFO handing items between pipeline threads. pop() blocks until an
+// item arrives or the queue is closed; items pushed before close() are still
+// delivered. Memory is bounded by the caller circulating a fixed set of items.
+template <typename T>
+class BlockingQueue {
+public:
+    void push(T item) {
+        {
+            std::lock_guard<std::mutex> lock(mtx);
+            if (closed) return;
+            items.push_back(std::move(item));
+        }
+        cv.notify_one();
+    }
+
+    // Takes the oldest item; false once the queue is closed and drained
+    bool pop(T& item) {
+        std::unique_lock<std::mutex> lock(mtx);
+        cv.wait(lock, [this] { return closed || !items.empty(); });
+        if (items.empty()) return false;
+        item = std::move(items.front());
+        items.pop_front();
+        return true;
+    }
+
+    void close() {
+        {
+            std::lock_guard<std::mutex> lock(mtx);
+            closed = true;
+        }
+        cv.notify_all();
+    }
+
+private:
+    std::mutex mtx;
+    std::condition_variable cv;
+    std::deque<T> items;
+    bool closed = false;
+};
+
+#endif // BLOCKING_QUEUE_H
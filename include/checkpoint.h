@@ -0,0 +1,31 @@
+#ifndef CHECKPOINT_H
+#define CHECKPOINT_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Progress of a compression run at a slab boundary: every block of the
+// first slabs_done slabs is in the output file, whose first output_offset
+// bytes are exactly those blocks (and the binary header, if any), and the
+// next slab starts at input_offset in the input file. Resuming truncates the
+// output to output_offset and carries on from there, with the same options.
+struct Checkpoint {
+    std::vector<int> spec; // x_count, y_count, z_count, parent_x, parent_y, parent_z
+    std::string format;    // --format, --growth and --slabs of the run
+    std::string growth;
+    std::string encoding;
+    int slabs_done = 0;
+    std::uint64_t input_offset = 0;
+    std::uint64_t output_offset = 0;
+
+    // Writes the checkpoint to a temporary file next to path and renames it
+    // over path, so a crash leaves either the old checkpoint or the new one.
+    // Throws std::runtime_error if it cannot be written.
+    void save(const std::string& path) const;
+
+    // Throws std::runtime_error if path is missing or malformed
+    static Checkpoint load(const std::string& path);
+};
+
+#endif // CHECKPOINT_H
@@ -0,0 +1,153 @@
+#ifndef FIXED_GROWTH_H
+#define FIXED_GROWTH_H
+
+#include "block.h"
+#include "block_sink.h"
+#include "flat3d.h"
+#include <algorithm>
+#include <cstdint>
+
+// Greedy BlockGrowth specialised at compile time for one parent block size
+// whose z-planes fit in a 64-bit word (W * H <= 64). Every tag's cells and the
+// uncompressed mask are held as one word per plane on the stack, so fitting a
+// cube and testing a growth face are a handful of shifts and ANDs in fully
+// unrolled loops. Emits exactly the blocks BlockGrowth's greedy strategy does.
+template <int W, int H, int D>
+class FixedGrowth {
+    static_assert(W * H <= 64, "a plane must fit in one 64-bit word");
+
+public:
+    // parent gives the block's absolute position; model is its cells
+    static void run(const Flat3DView<const char>& model, const Block& parent, BlockSink& out) {
+        // Per distinct tag: its byte, uncompressed cell count and cell planes
+        char tags[W * H * D];
+        int counts[W * H * D];
+        Plane cells[W * H * D][D];
+        int n_tags = 0;
+
+        int last = -1;
+        for (int z = 0; z < D; ++z) {
+            for (int y = 0; y < H; ++y) {
+                const char* row = &model.at(z, y, 0);
+                for (int x = 0; x < W; ++x) {
+                    if (last < 0 || tags[last] != row[x]) {
+                        last = 0;
+                        while (last < n_tags && tags[last] != row[x])
+                            ++last;
+                        if (last == n_tags) {
+                            tags[n_tags] = row[x];
+                            counts[n_tags] = 0;
+                            std::fill(cells[n_tags], cells[n_tags] + D, Plane{0});
+                            ++n_tags;
+                        }
+                    }
+                    cells[last][z] |= Plane{1} << (y * W + x);
+                    ++counts[last];
+                }
+            }
+        }
+
+        Plane uncompressed[D];
+        std::fill(uncompressed, uncompressed + D, rect(0, H, 0, W));
+        int remaining = W * H * D;
+        const int cube_size = std::min({W, H, D});
+
+        while (remaining > 0) {
+            // Most common uncompressed tag; ties go to the lowest tag byte
+            int mode = 0;
+            for (int i = 1; i < n_tags; ++i)
+                if (counts[i] > counts[mode] ||
+                    (counts[i] == counts[mode] &&
+                     static_cast<unsigned char>(tags[i]) < static_cast<unsigned char>(tags[mode])))
+                    mode = i;
+
+            Plane avail[D];
+            for (int z = 0; z < D; ++z)
+                avail[z] = cells[mode][z] & uncompressed[z];
+
+            // fit[z] holds the origins of cubes of size s starting in plane z.
+            // A cube of size s is four cubes of size s - 1 in each of two
+            // adjacent planes, so each size is derived from the one below.
+            Plane fit[D];
+            std::copy(avail, avail + D, fit);
+            int s = 1;
+            for (int next_s = 2; next_s <= cube_size; ++next_s) {
+                Plane next[D];
+                Plane any = 0;
+                for (int z = 0; z + next_s <= D; ++z) {
+                    next[z] = square(fit[z]) & square(fit[z + 1]) & origins(next_s);
+                    any |= next[z];
+                }
+                if (!any) break;
+                std::copy(next, next + D - next_s + 1, fit);
+                s = next_s;
+            }
+
+            int z = 0;
+            while (fit[z] == 0)
+                ++z;
+            int bit = __builtin_ctzll(fit[z]);
+            int y = bit / W, x = bit % W;
+            int w = s, h = s, d = s;
+
+            // Greedy growth: +Z, else +Y, else +X, one layer at a time
+            while (true) {
+                if (z + d < D && covers(avail[z + d], rect(y, y + h, x, x + w))) {
+                    ++d;
+                } else if (y + h < H && covers_all(avail, z, z + d, rect(y + h, y + h + 1, x, x + w))) {
+                    ++h;
+                } else if (x + w < W && covers_all(avail, z, z + d, rect(y, y + h, x + w, x + w + 1))) {
+                    ++w;
+                } else {
+                    break;
+                }
+            }
+
+            Plane box = rect(y, y + h, x, x + w);
+            for (int k = z; k < z + d; ++k)
+                uncompressed[k] &= ~box;
+            counts[mode] -= w * h * d;
+            remaining -= w * h * d;
+
+            out.emit(Block(parent.x + x, parent.y + y, parent.z + z, w, h, d, tags[mode], x, y, z));
+        }
+    }
+
+private:
+    using Plane = std::uint64_t;
+
+    // Bits of the cells [y0,y1) x [x0,x1) of a plane
+    static constexpr Plane rect(int y0, int y1, int x0, int x1) {
+        Plane row = (x1 - x0 == 64) ? ~Plane{0} : ((Plane{1} << (x1 - x0)) - 1) << x0;
+        Plane m = 0;
+        for (int y = y0; y < y1; ++y)
+            m |= row << (y * W);
+        return m;
+    }
+
+    // Cells that can be the origin of a cube of size s
+    static constexpr Plane origins(int s) {
+        return rect(0, H - s + 1, 0, W - s + 1);
+    }
+
+    // Cells whose 2x2 square of the next cells right and below are all set
+    static inline Plane square(Plane p) {
+        return p & (p >> 1) & (p >> W) & (p >> (W + 1));
+    }
+
+    static inline bool covers(Plane avail, Plane window) {
+        return (avail & window) == window;
+    }
+
+    static inline bool covers_all(const Plane* avail, int z0, int z1, Plane window) {
+        for (int z = z0; z < z1; ++z)
+            if (!covers(avail[z], window)) return false;
+        return true;
+    }
+};
+
+// Runs the specialised greedy growth if the parent block has one of the
+// compiled-in sizes. Returns false (and emits nothing) otherwise.
+bool run_fixed_growth(const Flat3DView<const char>& model, const Block& parent, BlockSink& out);
+
+#endif // FIXED_GROWTH_H
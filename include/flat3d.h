@@ -0,0 +1,58 @@
+#ifndef FLAT3D_H
+#define FLAT3D_H
+
+#include <cstddef>
+#include <type_traits>
+#include <vector>
+
+// Flattened 3D container: [depth][height][width]
+template <typename T>
+class Flat3D {
+public:
+    int depth, height, width;
+    std::vector<T> data;
+
+    Flat3D() : depth(0), height(0), width(0) {}
+    Flat3D(int d, int h, int w, T init = T()) : depth(d), height(h), width(w), data(d * h * w, init) {}
+
+    inline T& at(int z, int y, int x) {
+        return data[(z * height + y) * width + x];
+    }
+
+    inline const T& at(int z, int y, int x) const {
+        return data[(z * height + y) * width + x];
+    }
+};
+
+// Non-owning, strided window onto a Flat3D (or any [depth][height][width]
+// buffer whose rows are contiguous). Lets a sub-volume be processed in place
+// instead of being copied out.
+template <typename T>
+class Flat3DView {
+public:
+    int depth, height, width;
+
+    Flat3DView() : depth(0), height(0), width(0), base(nullptr), row_stride(0), plane_stride(0) {}
+    Flat3DView(T* base, int d, int h, int w, std::ptrdiff_t row_stride, std::ptrdiff_t plane_stride)
+        : depth(d), height(h), width(w), base(base), row_stride(row_stride), plane_stride(plane_stride) {}
+
+    // Whole-grid view
+    Flat3DView(const Flat3D<std::remove_const_t<T>>& src)
+        : Flat3DView(src.data.data(), src.depth, src.height, src.width, src.width,
+                     static_cast<std::ptrdiff_t>(src.height) * src.width) {}
+
+    inline T& at(int z, int y, int x) const {
+        return base[z * plane_stride + y * row_stride + x];
+    }
+
+    // View of [z0,z1) x [y0,y1) x [x0,x1) of this view
+    Flat3DView sub(int z0, int z1, int y0, int y1, int x0, int x1) const {
+        return Flat3DView(&at(z0, y0, x0), z1 - z0, y1 - y0, x1 - x0, row_stride, plane_stride);
+    }
+
+private:
+    T* base;
+    std::ptrdiff_t row_stride, plane_stride;
+};
+
+#endif // FLAT3D_H
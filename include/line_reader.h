@@ -0,0 +1,45 @@
+#ifndef LINE_READER_H
+#define LINE_READER_H
+
+#include <cstddef>
+#include <istream>
+#include <vector>
+
+// Buffered line reader over an istream's streambuf. Input is pulled in large
+// blocks (sgetn) into a reusable buffer and lines are found with memchr, so a
+// row costs no per-character stream calls and no std::string. A trailing '\r'
+// is stripped so CRLF input reads the same as LF input.
+//
+// The reader can also walk an in-memory buffer (e.g. a memory-mapped file),
+// in which case lines point straight into that buffer.
+class LineReader {
+public:
+    explicit LineReader(std::istream& in, std::size_t buffer_size = 1 << 20);
+    LineReader(const char* data, std::size_t size);
+
+    // Points line/len at the next line (without its terminator). The data stays
+    // valid until the next call. Returns false, with len = 0, at end of input.
+    bool next_line(const char*& line, std::size_t& len);
+
+    // Absolute byte offset of the next unread line
+    std::size_t offset() const {
+        return origin + pos;
+    }
+
+    // Repositions an in-memory reader at an absolute byte offset
+    void seek(std::size_t offset);
+
+private:
+    std::streambuf* src = nullptr; // null when reading from memory
+    std::vector<char> buf;
+    const char* base = nullptr; // buf.data() or the caller's buffer
+    std::size_t origin = 0;     // absolute offset of base[0]
+    std::size_t pos = 0;        // start of unread data
+    std::size_t end = 0;        // end of buffered data
+    std::size_t scan = 0;       // bytes after pos already known to hold no '\n'
+    bool eof = false;
+
+    void refill();
+};
+
+#endif // LINE_READER_H
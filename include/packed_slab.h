@@ -0,0 +1,80 @@
+#ifndef PACKED_SLAB_H
+#define PACKED_SLAB_H
+
+#include <cstddef>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// Dense ids for the tags of a tag table: its tags numbered 0..k-1 in byte
+// order, so ids compare the same way as the tag bytes they stand for
+class TagIds {
+public:
+    TagIds();
+    explicit TagIds(const std::unordered_map<char, std::string>& tag_table);
+
+    // Id of tag, or -1 if it is not in the table
+    int id(char tag) const {
+        return ids[static_cast<unsigned char>(tag)];
+    }
+
+    char tag(int id) const {
+        return tags[id];
+    }
+
+    int count() const {
+        return n;
+    }
+
+private:
+    int ids[256];
+    char tags[256];
+    int n = 0;
+};
+
+// [depth][height][width] grid of tag ids stored two to a byte, low nibble
+// first, for models of at most MAX_TAGS tags: half the memory of a dense slab
+// whatever the model looks like. Rows start on a byte boundary and are
+// appended in z, y order while the input is parsed.
+class PackedSlab {
+public:
+    static const int MAX_TAGS = 16;
+
+    // Sets the tags rows are encoded with; ids must have at most MAX_TAGS
+    void set_tags(const TagIds& ids);
+
+    // Drops every row and sets the shape; storage is reused
+    void reset(int d, int h, int w);
+
+    // Appends the next row (width bytes) in z, y order. Returns false, and
+    // appends nothing, if the row has a tag that is not in the tag table.
+    bool append_row(const char* row);
+
+    char tag_at(int z, int y, int x) const {
+        unsigned char pair = cells[row_offset(z, y) + x / 2];
+        return pair_tags[pair][x & 1];
+    }
+
+    // Writes the tags of columns [x0,x1) of row (z,y) to out
+    void decode(int z, int y, int x0, int x1, char* out) const;
+
+    std::size_t byte_count() const {
+        return cells.size();
+    }
+
+    int depth = 0, height = 0, width = 0;
+
+private:
+    std::vector<unsigned char> cells;
+    std::size_t row_bytes = 0;
+    std::size_t rows = 0; // rows appended so far
+
+    signed char tag_id[256];     // tag byte -> id, -1 if not in the table
+    char pair_tags[256][2];      // packed byte -> its two tags, low nibble first
+
+    std::size_t row_offset(int z, int y) const {
+        return (static_cast<std::size_t>(z) * height + y) * row_bytes;
+    }
+};
+
+#endif // PACKED_SLAB_H
@@ -0,0 +1,69 @@
+#ifndef RLE_SLAB_H
+#define RLE_SLAB_H
+
+#include <cstddef>
+#include <vector>
+
+// How BlockModel keeps a slab of the model in memory
+enum class SlabEncoding {
+    Dense,  // one byte per cell (or a view into the mapped input)
+    Rle,    // runs of equal tags per row, see RleSlab
+    Packed  // tag ids two to a byte, see PackedSlab (dense when over 16 tags,
+            // or for a slab with a tag outside the tag table)
+};
+
+// Run-length encoded [depth][height][width] grid of tags. Each row is stored as
+// its runs (start column and tag), so a row of one tag costs one run however
+// wide the model is. Rows are appended in z, y order while the input is parsed.
+class RleSlab {
+public:
+    // Drops every row and sets the shape; storage is reused
+    void reset(int d, int h, int w);
+
+    // Appends the next row (width bytes) in z, y order
+    void append_row(const char* row);
+
+    // Index of the run covering column x of row (z,y)
+    int run_at(int z, int y, int x) const;
+
+    char run_tag(int run) const {
+        return tags[run];
+    }
+
+    int run_start(int run) const {
+        return starts[run];
+    }
+
+    // One past the last column of a run of row (z,y)
+    int run_end(int z, int y, int run) const {
+        return run + 1 < row_begin[row(z, y) + 1] ? starts[run + 1] : width;
+    }
+
+    char tag_at(int z, int y, int x) const {
+        return tags[run_at(z, y, x)];
+    }
+
+    // True if every cell of [z0,z1) x [y0,y1) x [x0,x1) is tag; each row is
+    // one run lookup
+    bool window_is(char tag, int z0, int z1, int y0, int y1, int x0, int x1) const;
+
+    // Writes columns [x0,x1) of row (z,y) to out
+    void decode(int z, int y, int x0, int x1, char* out) const;
+
+    std::size_t run_count() const {
+        return tags.size();
+    }
+
+    int depth = 0, height = 0, width = 0;
+
+private:
+    std::vector<int> starts;    // start column of every run, row after row
+    std::vector<char> tags;     // tag of every run
+    std::vector<int> row_begin; // first run of each row; rows + 1 entries
+
+    int row(int z, int y) const {
+        return z * height + y;
+    }
+};
+
+#endif // RLE_SLAB_H
@@ -0,0 +1,41 @@
+#ifndef ROW_KERNELS_H
+#define ROW_KERNELS_H
+
+// Vectorised kernels over a contiguous span of tag bytes (a Flat3D<char> row
+// or part of one). Spans shorter than one SSE register are handled inline;
+// longer ones go to an implementation (AVX2, SSE2 or scalar) picked once at
+// startup from what the CPU supports. All of them return identical results.
+
+int row_find_mismatch_wide(const char* row, int n, char tag);
+int row_find_match_wide(const char* row, int n, char tag);
+int row_count_matches_wide(const char* row, int n, char tag);
+
+// Index of the first byte in row[0, n) that differs from tag, or n
+inline int row_find_mismatch(const char* row, int n, char tag) {
+    if (n >= 16) return row_find_mismatch_wide(row, n, tag);
+    for (int i = 0; i < n; ++i)
+        if (row[i] != tag) return i;
+    return n;
+}
+
+// Index of the first byte in row[0, n) equal to tag, or n
+inline int row_find_match(const char* row, int n, char tag) {
+    if (n >= 16) return row_find_match_wide(row, n, tag);
+    for (int i = 0; i < n; ++i)
+        if (row[i] == tag) return i;
+    return n;
+}
+
+// Number of bytes in row[0, n) equal to tag
+inline int row_count_matches(const char* row, int n, char tag) {
+    if (n >= 16) return row_count_matches_wide(row, n, tag);
+    int count = 0;
+    for (int i = 0; i < n; ++i)
+        count += row[i] == tag ? 1 : 0;
+    return count;
+}
+
+// Name of the selected implementation: "avx2", "sse2" or "scalar"
+const char* row_kernels_isa();
+
+#endif // ROW_KERNELS_H
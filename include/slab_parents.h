@@ -0,0 +1,87 @@
+#ifndef SLAB_PARENTS_H
+#define SLAB_PARENTS_H
+
+#include "block.h"
+#include "block_growth.h"
+#include "block_sink.h"
+#include "flat3d.h"
+#include <algorithm>
+#include <cstddef>
+#include <vector>
+
+// Model size and parent block size, as given on the specification line
+struct ModelSpec {
+    int x_count = 0, y_count = 0, z_count = 0;
+    int parent_x = 0, parent_y = 0, parent_z = 0;
+};
+
+// The parent blocks of one slab, shared by BlockModel and BlockCompressor so
+// both lay out, summarise and compress parents the same way. Parents are in
+// (y, x) order; each carries the tag of its first cell, and a parent whose
+// cells all have that tag is uniform and compresses to itself.
+class SlabParents {
+public:
+    // Lays out the parents of slices [top_slice, top_slice + n_slices), all
+    // taken as uniform until their rows say otherwise
+    void reset(const ModelSpec& spec, int top_slice, int n_slices);
+
+    // Folds row (z, y) of the slab (x_count tags) into the uniform-tag
+    // summary. Rows must arrive in z, y order, so a parent's first row sets
+    // its tag.
+    void summarize_row(int z, int y, const char* row);
+
+    // Sets a parent's summary directly (e.g. from a run-length encoded slab)
+    void set_summary(std::size_t i, char tag, bool uniform);
+
+    std::size_t size() const {
+        return parents.size();
+    }
+
+    const Block& operator[](std::size_t i) const {
+        return parents[i];
+    }
+
+    bool uniform(std::size_t i) const {
+        return uniform_[i] != 0;
+    }
+
+    // Parents are compressed in runs of consecutive parents, one pool task
+    // and one output buffer per run, so a slab of many small parents costs a
+    // few dozen tasks and buffers rather than one per parent. Run r is
+    // parents [run_begin(r), run_begin(r + 1)).
+    std::size_t run_count() const {
+        return (parents.size() + run_length - 1) / run_length;
+    }
+
+    std::size_t run_begin(std::size_t r) const {
+        return std::min(r * run_length, parents.size());
+    }
+
+    int top_slice() const {
+        return top;
+    }
+
+    int n_slices() const {
+        return depth;
+    }
+
+private:
+    ModelSpec spec;
+    int top = 0, depth = 0;
+    int per_row = 0; // parents across x
+    std::vector<Block> parents;
+    std::vector<char> uniform_;
+
+    // A run covers at least MIN_RUN_CELLS cells, unless that would leave
+    // the slab fewer than MIN_RUNS runs to balance across threads
+    static const int MIN_RUN_CELLS = 4096;
+    static const std::size_t MIN_RUNS = 64;
+    std::size_t run_length = 1;
+};
+
+// Emits a uniform parent block as it is and grows the others. model is the
+// parent's own cells.
+void compress_parent_block(const Flat3DView<const char>& model, const Block& parent, bool uniform,
+                           GrowthStrategy strategy, BlockSink& out);
+
+#endif // SLAB_PARENTS_H
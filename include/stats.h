@@ -0,0 +1,108 @@
+#ifndef STATS_H
+#define STATS_H
+
+// Hot-path counters and phase timers behind --stats. Everything here is
+// compiled out unless BLOCK_STATS is non-zero (the Makefile's STATS option,
+// on by default); when compiled in, nothing is counted or timed until
+// Stats::enabled is set, so an unused build pays one predictable branch per
+// counter.
+
+#ifndef BLOCK_STATS
+#define BLOCK_STATS 0
+#endif
+
+#include <chrono>
+#include <cstdint>
+#include <ostream>
+#include <string>
+#include <vector>
+
+// Counts of the work done inside parent block compression. Each thread
+// keeps its own, so counting needs no atomics.
+struct StatCounters {
+    std::uint64_t parents_fixed = 0;   // greedy parents handled by FixedGrowth
+    std::uint64_t parents_grown = 0;   // parents handled by BlockGrowth
+    std::uint64_t parent_decodes = 0;  // parents expanded from an encoded slab
+    std::uint64_t fit_calls = 0;       // fit_block calls (one per block emitted)
+    std::uint64_t fit_shrinks = 0;     // cube sizes rejected while fitting
+    std::uint64_t window_checks = 0;   // window_is_all + window_is_all_uncompressed
+    std::uint64_t grow_steps = 0;      // grow_block iterations (layers tried)
+
+    StatCounters& operator+=(const StatCounters& o);
+};
+
+// Timings and results of one slab, filled in as it moves through the model
+struct SlabStats {
+    int top_slice = 0, n_slices = 0;
+    std::uint64_t parents = 0, uniform_parents = 0, blocks = 0;
+    double read_seconds = 0.0;     // parsing and copying the slab's rows
+    double compress_seconds = 0.0; // summed over parent blocks (thread time)
+    double write_seconds = 0.0;    // formatting and writing the output
+
+    // The parent block that took longest to compress
+    int slowest_x = 0, slowest_y = 0;
+    double slowest_seconds = 0.0;
+    std::uint64_t slowest_blocks = 0;
+};
+
+// Timing and block count of one parent block
+struct ParentStats {
+    double seconds = 0.0;
+    std::uint64_t blocks = 0;
+};
+
+class Stats {
+public:
+    static inline bool enabled = false;
+
+    // This thread's counters
+    static StatCounters& local();
+
+    // Sum of every thread's counters
+    static StatCounters total();
+
+    // Zeroes every thread's counters (no compression may be running)
+    static void reset();
+
+    static double seconds_since(std::chrono::steady_clock::time_point start) {
+        return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    }
+};
+
+#if BLOCK_STATS
+#define STATS_COUNT(field, n)                              \
+    do {                                                   \
+        if (Stats::enabled) Stats::local().field += (n);   \
+    } while (0)
+#else
+#define STATS_COUNT(field, n) \
+    do {                      \
+    } while (0)
+#endif
+
+// Collects per-slab figures for a run and writes the JSON report
+class StatsReport {
+public:
+    struct Run {
+        int x_count = 0, y_count = 0, z_count = 0;
+        int parent_x = 0, parent_y = 0, parent_z = 0;
+        unsigned int threads = 1;
+        std::string strategy;
+        double header_seconds = 0.0; // specification and tag table
+        double wall_seconds = 0.0;   // from the start of read_model to the end
+    };
+
+    Run run;
+
+    void add_slab(const SlabStats& slab) {
+        slabs.push_back(slab);
+    }
+
+    // {"model": ..., "phases": ..., "counters": ..., "totals": ..., "slabs": [...]}
+    void write_json(std::ostream& out, const StatCounters& counters) const;
+
+private:
+    std::vector<SlabStats> slabs;
+};
+
+#endif // STATS_H
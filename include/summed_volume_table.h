@@ -0,0 +1,34 @@
+#ifndef SUMMED_VOLUME_TABLE_H
+#define SUMMED_VOLUME_TABLE_H
+
+#include "flat3d.h"
+#include <vector>
+
+// 3D prefix-sum ("summed-volume") table over a [depth][height][width] grid.
+// Entry (z,y,x) holds the number of counted cells in [0,z) x [0,y) x [0,x),
+// so the count inside any axis-aligned window is an 8-term lookup.
+class SummedVolumeTable {
+public:
+    // Rebuilds this table in place (reusing its storage) to count src == tag
+    void build(const Flat3DView<const char>& src, char tag);
+
+    // Number of counted cells in [z0,z1) x [y0,y1) x [x0,x1)
+    inline int sum(int z0, int z1, int y0, int y1, int x0, int x1) const {
+        return at(z1, y1, x1) - at(z0, y1, x1) - at(z1, y0, x1) - at(z1, y1, x0)
+             + at(z0, y0, x1) + at(z0, y1, x0) + at(z1, y0, x0) - at(z0, y0, x0);
+    }
+
+private:
+    int depth = 0, height = 0, width = 0;
+    std::vector<int> data; // (depth+1) x (height+1) x (width+1)
+
+    inline int& at(int z, int y, int x) {
+        return data[(z * (height + 1) + y) * (width + 1) + x];
+    }
+
+    inline int at(int z, int y, int x) const {
+        return data[(z * (height + 1) + y) * (width + 1) + x];
+    }
+};
+
+#endif // SUMMED_VOLUME_TABLE_H
@@ -0,0 +1,85 @@
+#ifndef THREAD_POOL_H
+#define THREAD_POOL_H
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Set of tasks submitted together (e.g. the parent blocks of one slab).
+// ThreadPool::wait blocks until every task of the group has finished.
+class TaskGroup {
+public:
+    TaskGroup() = default;
+    TaskGroup(const TaskGroup&) = delete;
+    TaskGroup& operator=(const TaskGroup&) = delete;
+
+private:
+    friend class ThreadPool;
+    std::atomic<std::size_t> pending{0};
+    std::mutex error_mtx;
+    std::exception_ptr error;
+};
+
+// Work-stealing pool of worker threads used to compress parent blocks in
+// parallel. Every worker owns a task queue; tasks submitted from outside are
+// spread over the queues round-robin, and a worker whose queue is empty steals
+// from the others. Owners and thieves both take the oldest task, so tasks
+// (and the slabs they belong to) tend to finish in submission order.
+//
+// A thread blocked in wait() runs queued tasks meanwhile, so a pool created
+// for N threads only spawns N - 1 workers.
+class ThreadPool {
+public:
+    explicit ThreadPool(unsigned int threads);
+    ~ThreadPool();
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    // Total number of threads running tasks (workers + a waiting caller)
+    unsigned int size() const {
+        return static_cast<unsigned int>(workers.size()) + 1;
+    }
+
+    // Queues task as part of group. Safe to call from any thread.
+    void submit(TaskGroup& group, std::function<void()> task);
+
+    // Runs queued tasks until every task of group has finished, then
+    // rethrows the first exception one of them threw (if any)
+    void wait(TaskGroup& group);
+
+private:
+    struct Task {
+        TaskGroup* group;
+        std::function<void()> fn;
+    };
+
+    struct Queue {
+        std::mutex mtx;
+        std::deque<Task> tasks;
+    };
+
+    std::vector<std::thread> workers;
+    std::vector<std::unique_ptr<Queue>> queues; // one per worker, plus one for waiters
+
+    std::atomic<std::size_t> queued{0};
+    std::atomic<std::size_t> next_queue{0};
+
+    // Sleeping threads wait here for new tasks or a finished group
+    std::mutex mtx;
+    std::condition_variable cv;
+    bool stopping = false;
+
+    void worker_loop(std::size_t self);
+    bool try_run(std::size_t self);
+    void run(Task& task);
+};
+
+#endif // THREAD_POOL_H
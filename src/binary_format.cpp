@@ -0,0 +1,180 @@
+#include "binary_format.h"
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+
+using std::string;
+using std::unordered_map;
+using std::vector;
+
+static const char MAGIC[4] = {'B', 'L', 'K', 'C'};
+static const int VERSION = 1;
+
+// Appends v as a LEB128 varint at out and returns the end of the encoding
+static std::uint8_t* put_varint(std::uint8_t* out, std::uint32_t v) {
+    while (v >= 0x80) {
+        *out++ = static_cast<std::uint8_t>(v | 0x80);
+        v >>= 7;
+    }
+    *out++ = static_cast<std::uint8_t>(v);
+    return out;
+}
+
+static std::uint32_t zigzag(int v) {
+    return (static_cast<std::uint32_t>(v) << 1) ^ static_cast<std::uint32_t>(v >> 31);
+}
+
+static int unzigzag(std::uint32_t v) {
+    return static_cast<int>((v >> 1) ^ (0u - (v & 1)));
+}
+
+static void write_varint(std::ostream& out, std::uint32_t v) {
+    std::uint8_t bytes[5];
+    std::uint8_t* end = put_varint(bytes, v);
+    out.write(reinterpret_cast<const char*>(bytes), end - bytes);
+}
+
+BinaryHeader::BinaryHeader(const vector<int>& spec, const unordered_map<char, string>& tag_table) {
+    if (spec.size() != 6) throw std::runtime_error("Binary header needs 6 spec values.");
+    x_count = spec[0];
+    y_count = spec[1];
+    z_count = spec[2];
+    parent_x = spec[3];
+    parent_y = spec[4];
+    parent_z = spec[5];
+    tags.assign(tag_table.begin(), tag_table.end());
+    std::sort(tags.begin(), tags.end(), [](const std::pair<char, string>& a, const std::pair<char, string>& b) {
+        return static_cast<unsigned char>(a.first) < static_cast<unsigned char>(b.first);
+    });
+}
+
+unordered_map<char, string> BinaryHeader::tag_table() const {
+    return unordered_map<char, string>(tags.begin(), tags.end());
+}
+
+void write_binary_header(std::ostream& out, const BinaryHeader& header) {
+    out.write(MAGIC, sizeof(MAGIC));
+    out.put(static_cast<char>(VERSION));
+    for (int v : {header.x_count, header.y_count, header.z_count, header.parent_x, header.parent_y, header.parent_z})
+        write_varint(out, static_cast<std::uint32_t>(v));
+    write_varint(out, static_cast<std::uint32_t>(header.tags.size()));
+    for (const auto& tag : header.tags) {
+        out.put(tag.first);
+        write_varint(out, static_cast<std::uint32_t>(tag.second.size()));
+        out.write(tag.second.data(), static_cast<std::streamsize>(tag.second.size()));
+    }
+}
+
+BinaryBlockBuffer::BinaryBlockBuffer() {}
+
+void BinaryBlockBuffer::emit(const Block& b) {
+    const std::size_t max_record = 6 * 5 + 1;
+    if (len + max_record > buf.size()) buf.resize(std::max(buf.size() * 2, len + max_record));
+
+    std::uint8_t* out = buf.data() + len;
+    out = put_varint(out, zigzag(b.x - prev_x));
+    out = put_varint(out, zigzag(b.y - prev_y));
+    out = put_varint(out, zigzag(b.z - prev_z));
+    out = put_varint(out, static_cast<std::uint32_t>(b.width));
+    out = put_varint(out, static_cast<std::uint32_t>(b.height));
+    out = put_varint(out, static_cast<std::uint32_t>(b.depth));
+    *out++ = static_cast<std::uint8_t>(b.tag);
+    len = static_cast<std::size_t>(out - buf.data());
+
+    prev_x = b.x;
+    prev_y = b.y;
+    prev_z = b.z;
+    ++blocks;
+}
+
+void BinaryBlockBuffer::write_to(std::ostream& out) {
+    if (blocks == 0) return;
+    write_varint(out, blocks);
+    out.write(reinterpret_cast<const char*>(buf.data()), static_cast<std::streamsize>(len));
+}
+
+void BinaryBlockBuffer::clear() {
+    len = 0;
+    blocks = 0;
+    prev_x = prev_y = prev_z = 0;
+}
+
+BinaryBlockReader::BinaryBlockReader(std::istream& in) : src(in.rdbuf()) {
+    char magic[sizeof(MAGIC)];
+    if (src->sgetn(magic, sizeof(magic)) != sizeof(magic) || std::memcmp(magic, MAGIC, sizeof(MAGIC)) != 0)
+        throw std::runtime_error("Not a binary block stream.");
+    if (read_byte() != VERSION) throw std::runtime_error("Unsupported binary block stream version.");
+
+    hdr.x_count = read_int();
+    hdr.y_count = read_int();
+    hdr.z_count = read_int();
+    hdr.parent_x = read_int();
+    hdr.parent_y = read_int();
+    hdr.parent_z = read_int();
+    std::uint32_t n_tags = read_varint();
+    if (n_tags > 256) throw std::runtime_error("Invalid tag count in binary header.");
+    for (std::uint32_t i = 0; i < n_tags; ++i) {
+        char tag = static_cast<char>(read_byte());
+        string label(read_varint(), '\0');
+        if (src->sgetn(&label[0], static_cast<std::streamsize>(label.size())) !=
+            static_cast<std::streamsize>(label.size()))
+            throw std::runtime_error("Truncated binary header.");
+        hdr.tags.emplace_back(tag, label);
+    }
+}
+
+bool BinaryBlockReader::next(Block& b) {
+    while (chunk_left == 0) {
+        if (src->sgetc() == std::char_traits<char>::eof()) return false;
+        chunk_left = read_varint();
+        prev_x = prev_y = prev_z = 0;
+    }
+
+    int x = prev_x + unzigzag(read_varint());
+    int y = prev_y + unzigzag(read_varint());
+    int z = prev_z + unzigzag(read_varint());
+    int w = read_int(), h = read_int(), d = read_int();
+    b = Block(x, y, z, w, h, d, static_cast<char>(read_byte()));
+
+    prev_x = x;
+    prev_y = y;
+    prev_z = z;
+    --chunk_left;
+    return true;
+}
+
+int BinaryBlockReader::read_byte() {
+    int c = src->sbumpc();
+    if (c == std::char_traits<char>::eof()) throw std::runtime_error("Truncated binary block stream.");
+    return c;
+}
+
+std::uint32_t BinaryBlockReader::read_varint() {
+    std::uint32_t v = 0;
+    for (int shift = 0; shift < 35; shift += 7) {
+        int c = read_byte();
+        v |= static_cast<std::uint32_t>(c & 0x7F) << shift;
+        if (!(c & 0x80)) return v;
+    }
+    throw std::runtime_error("Invalid varint in binary block stream.");
+}
+
+int BinaryBlockReader::read_int() {
+    return static_cast<int>(read_varint());
+}
+
+void binary_to_text(std::istream& in, std::ostream& out) {
+    BinaryBlockReader reader(in);
+    LabelTable labels(reader.header().tag_table());
+    TextBlockBuffer text(labels);
+
+    Block b(0, 0, 0, 0, 0, 0, '\0');
+    while (reader.next(b)) {
+        text.emit(b);
+        if (text.size() >= (1 << 20)) {
+            text.write_to(out);
+            text.clear();
+        }
+    }
+    text.write_to(out);
+}
@@ -0,0 +1,129 @@
+#include "block_compressor.h"
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+
+using std::string;
+using std::unordered_map;
+using std::vector;
+
+BlockCompressor::BlockCompressor(const ModelSpec& spec, const unordered_map<char, string>& tag_table, BlockSink& out)
+    : model_spec(spec), label_table(tag_table), out(out) {
+    if (spec.x_count <= 0 || spec.y_count <= 0 || spec.z_count <= 0 || spec.parent_x <= 0 || spec.parent_y <= 0 ||
+        spec.parent_z <= 0)
+        throw std::runtime_error("Invalid model specification (every dimension must be positive).");
+}
+
+void BlockCompressor::set_num_threads(unsigned int threads) {
+    num_threads = std::max(1u, threads);
+    pool.reset();
+}
+
+void BlockCompressor::set_growth_strategy(GrowthStrategy strategy) {
+    growth_strategy = strategy;
+}
+
+void BlockCompressor::set_merge_mode(MergeMode mode) {
+    if (next_slice > 0) throw std::runtime_error("Merge mode must be set before the first slice is pushed.");
+    merge_mode = mode;
+}
+
+int BlockCompressor::slab_slices(int top_slice) const {
+    return std::min(model_spec.parent_z, model_spec.z_count - top_slice);
+}
+
+void BlockCompressor::push_slices(const char* slices, int n_slices) {
+    if (finished) throw std::runtime_error("Slices pushed after finish().");
+    if (n_slices < 0 || n_slices > model_spec.z_count - next_slice)
+        throw std::runtime_error("Pushed slices run past z_count.");
+    if (merge_mode != MergeMode::None && !merger) merger = std::make_unique<BlockMerger>(merge_mode, out);
+
+    const int x_count = model_spec.x_count, y_count = model_spec.y_count;
+    const std::size_t plane = static_cast<std::size_t>(y_count) * x_count;
+    while (n_slices > 0) {
+        int top_slice = next_slice - pending_slices;
+        int needed = slab_slices(top_slice) - pending_slices;
+
+        if (pending_slices == 0 && n_slices >= needed) {
+            // A whole slab in the caller's buffer: compress it where it is
+            compress_slab(Flat3DView<const char>(slices, needed, y_count, x_count, x_count,
+                                                 static_cast<std::ptrdiff_t>(plane)),
+                          top_slice);
+        } else {
+            if (pending.depth != model_spec.parent_z || pending.height != y_count || pending.width != x_count)
+                pending = Flat3D<char>(model_spec.parent_z, y_count, x_count);
+            needed = std::min(needed, n_slices);
+            std::memcpy(&pending.at(pending_slices, 0, 0), slices, needed * plane);
+            pending_slices += needed;
+            if (pending_slices == slab_slices(top_slice)) {
+                compress_slab(Flat3DView<const char>(pending).sub(0, pending_slices, 0, y_count, 0, x_count),
+                              top_slice);
+                pending_slices = 0;
+            }
+        }
+        slices += needed * plane;
+        n_slices -= needed;
+        next_slice += needed;
+    }
+}
+
+void BlockCompressor::finish() {
+    if (finished) return;
+    if (next_slice != model_spec.z_count)
+        throw std::runtime_error("Model incomplete: " + std::to_string(next_slice) + " of " +
+                                 std::to_string(model_spec.z_count) + " slices pushed.");
+    if (merger) merger->finish();
+    finished = true;
+}
+
+void BlockCompressor::compress_slab(const Flat3DView<const char>& slab, int top_slice) {
+    parents.reset(model_spec, top_slice, slab.depth);
+    for (int z = 0; z < slab.depth; ++z)
+        for (int y = 0; y < slab.height; ++y)
+            parents.summarize_row(z, y, &slab.at(z, y, 0));
+
+    auto compress = [&](std::size_t i, BlockSink& sink) {
+        const Block& p = parents[i];
+        compress_parent_block(slab.sub(0, p.depth, p.y, p.y_end, p.x, p.x_end), p, parents.uniform(i),
+                              growth_strategy, sink);
+    };
+
+    // Blocks go straight to out unless they are merged first
+    BlockSink& sink = merger ? static_cast<BlockSink&>(slab_blocks) : out;
+    slab_blocks.blocks.clear();
+
+    if (num_threads > 1 && !pool) pool = std::make_unique<ThreadPool>(num_threads);
+    if (pool) {
+        // One list per run of parent blocks, emitted in (y, x) order once all
+        // are done
+        std::size_t runs = parents.run_count();
+        if (lists.size() < runs) lists.resize(runs);
+        for (std::size_t r = 0; r < runs; ++r) {
+            lists[r].blocks.clear();
+            pool->submit(tasks, [this, &compress, r] {
+                for (std::size_t i = parents.run_begin(r); i < parents.run_begin(r + 1); ++i)
+                    compress(i, lists[r]);
+            });
+        }
+        pool->wait(tasks);
+        for (std::size_t r = 0; r < runs; ++r)
+            for (const Block& b : lists[r].blocks)
+                sink.emit(b);
+    } else {
+        for (std::size_t i = 0; i < parents.size(); ++i)
+            compress(i, sink);
+    }
+
+    if (merger) merger->add_slab(slab_blocks.blocks, top_slice + slab.depth);
+}
+
+vector<Block> compress_model(const ModelSpec& spec, const unordered_map<char, string>& tag_table,
+                             const char* voxels, GrowthStrategy strategy, unsigned int threads) {
+    BlockList blocks;
+    BlockCompressor compressor(spec, tag_table, blocks);
+    compressor.set_growth_strategy(strategy);
+    compressor.set_num_threads(threads);
+    compressor.push_slices(voxels, spec.z_count);
+    compressor.finish();
+    return std::move(blocks.blocks);
+}
@@ -1,164 +1,367 @@
 #include "block_growth.h"
+#include "fixed_growth.h"
+#include "row_kernels.h"
+#include "stats.h"
 #include <stdexcept>
 #include <algorithm>
 
-using std::string;
-using std::unordered_map;
+BlockGrowth::BlockGrowth(const Flat3DView<const char>& model_slices,
+                         GrowthStrategy strategy,
+                         GrowthScratch* scratch_)
+    : model(model_slices), strategy(strategy),
+      owned_scratch(scratch_ ? nullptr : new GrowthScratch()),
+      scratch(scratch_ ? *scratch_ : *owned_scratch),
+      compressed(scratch.compressed), tag_sums(scratch.tag_sums),
+      fit_cursor(scratch.fit_cursor), fit_cache(scratch.fit_cache) {
+    std::fill(std::begin(tag_slot), std::end(tag_slot), -1);
+    if (strategy == GrowthStrategy::Scanline) return; // works on row runs alone
 
-BlockGrowth::BlockGrowth(const Flat3D<char>& model_slices,
-                         const unordered_map<char, string>& tag_table)
-    : model(model_slices), tag_table(tag_table) {}
+    bool present[256] = {false};
+    for (int z = 0; z < model.depth; ++z)
+        for (int y = 0; y < model.height; ++y) {
+            const char* row = &model.at(z, y, 0);
+            for (int x = 0; x < model.width; ++x)
+                present[static_cast<unsigned char>(row[x])] = true;
+        }
 
-void BlockGrowth::run(Block parent_block_) {
+    for (int i = 0; i < 256; ++i) {
+        if (!present[i]) continue;
+        slot_tag[tag_count] = static_cast<char>(i);
+        tag_slot[i] = tag_count++;
+        if (static_cast<int>(tag_sums.size()) < tag_count) tag_sums.emplace_back();
+        tag_sums[tag_slot[i]].build(model, static_cast<char>(i));
+    }
+}
+
+void BlockGrowth::run(Block parent_block_, BlockSink& out) {
     parent_block = parent_block_;
     parent_x_end = parent_block.x_offset + parent_block.width;
     parent_y_end = parent_block.y_offset + parent_block.height;
     parent_z_end = parent_block.z_offset + parent_block.depth;
 
+    if (strategy == GrowthStrategy::Scanline) {
+        run_scanline(out);
+        return;
+    }
+    if (strategy == GrowthStrategy::Octree) {
+        run_octree(0, parent_block.depth, 0, parent_block.height, 0, parent_block.width, out);
+        return;
+    }
+
     // Initialise compressed mask to 0 (false)
-    compressed = Flat3D<char>(parent_block.depth,
-                              parent_block.height,
-                              parent_block.width,
-                              0);
+    compressed.reset(parent_block.depth, parent_block.height, parent_block.width);
+
+    // Every cell starts uncompressed; mark_compressed keeps these in step.
+    // Each row's leading run of its first tag is counted in one kernel call,
+    // so uniform rows never take the per-cell path.
+    std::fill(remaining_by_slot, remaining_by_slot + tag_count, 0);
+    for (int z = parent_block.z_offset; z < parent_z_end; ++z)
+        for (int y = parent_block.y_offset; y < parent_y_end; ++y) {
+            const char* row = &model.at(z, y, parent_block.x_offset);
+            int lead = row_find_mismatch(row, parent_block.width, row[0]);
+            remaining_by_slot[tag_slot[static_cast<unsigned char>(row[0])]] += lead;
+            for (int x = lead; x < parent_block.width; ++x)
+                ++remaining_by_slot[tag_slot[static_cast<unsigned char>(row[x])]];
+        }
+    remaining = parent_block.width * parent_block.height * parent_block.depth;
+
+    // Cleared rather than reassigned so each cache keeps its capacity
+    if (static_cast<int>(fit_cache.size()) < tag_count) fit_cache.resize(tag_count);
+    for (int i = 0; i < tag_count; ++i)
+        fit_cache[i].clear();
+    fit_cursor.assign(tag_count, 0);
 
     while (!all_compressed()) {
-        char mode = get_mode_of_uncompressed(parent_block);
+        char mode = get_mode_of_uncompressed();
         int cube_size = std::min({parent_block.width, parent_block.height, parent_block.depth});
-        Block b = fit_block(mode, cube_size, cube_size, cube_size);
-
-        auto it = tag_table.find(b.tag);
-        const string& label = (it == tag_table.end()) ? string(1, b.tag) : it->second;
-        b.print_block(label);
+        out.emit(fit_block(mode, cube_size));
     }
 }
 
 bool BlockGrowth::all_compressed() const {
-    for (char v : compressed.data)
-        if (v == 0) return false;
-    return true;
+    return remaining == 0;
 }
 
-char BlockGrowth::get_mode_of_uncompressed(const Block& blk) const {
-    int z0 = blk.z_offset, z1 = blk.z_offset + blk.depth;
-    int y0 = blk.y_offset, y1 = blk.y_offset + blk.height;
-    int x0 = blk.x_offset, x1 = blk.x_offset + blk.width;
-
-    int freq[256] = {0};
-    for (int z = z0; z < z1; ++z)
-        for (int y = y0; y < y1; ++y)
-            for (int x = x0; x < x1; ++x)
-                if (compressed.at(z, y, x) == 0) {
-                    unsigned char uc = static_cast<unsigned char>(model.at(z, y, x));
-                    ++freq[uc];
-                }
+// Only the tags present are counted, and slots follow byte order, so ties
+// still go to the lowest tag byte
+char BlockGrowth::get_mode_of_uncompressed() const {
+    int best = 0;
+    for (int i = 1; i < tag_count; ++i)
+        if (remaining_by_slot[i] > remaining_by_slot[best]) best = i;
+    return slot_tag[best];
+}
 
-    char best = 0;
-    int bestCount = -1;
-    for (int i = 0; i < 256; ++i) {
-        if (freq[i] > bestCount) {
-            bestCount = freq[i];
-            best = static_cast<char>(i);
+// Finds the largest cube (up to cube_size) of uncompressed 'mode' cells and,
+// among equally large ones, the first origin in z, y, x order, which is the
+// cube the original shrink-and-rescan search returned. Cells before the tag's
+// cursor can never be an origin again, and the cached size at each origin is
+// an upper bound (cells only ever become compressed), so origins that cannot
+// beat the best cube so far are skipped without a window check.
+Block BlockGrowth::fit_block(char mode, int cube_size) {
+    STATS_COUNT(fit_calls, 1);
+    int slot = tag_slot[static_cast<unsigned char>(mode)];
+    if (slot < 0) throw std::runtime_error("No fitting block found at minimal size.");
+
+    int pw = parent_block.width, ph = parent_block.height;
+    int plane = pw * ph;
+    int total = plane * parent_block.depth;
+
+    std::vector<int>& cache = fit_cache[slot];
+    if (cache.empty()) {
+        cache.resize(total);
+        for (int i = 0; i < total; ++i) {
+            int z = i / plane, y = (i / pw) % ph, x = i % pw;
+            cache[i] = std::min({cube_size, parent_z_end - z, parent_y_end - y, parent_x_end - x});
         }
     }
-    return best;
-}
 
-Block BlockGrowth::fit_block(char mode, int width, int height, int depth) {
-    for (int z = parent_block.z; z < parent_block.z_end; ++z) {
-        int z_off = z - parent_block.z;
-        int z_end = z_off + depth;
-        if (z_end > parent_z_end) break;
-
-        for (int y = parent_block.y; y < parent_block.y_end; ++y) {
-            int y_off = y - parent_block.y;
-            int y_end = y_off + height;
-            if (y_end > parent_y_end) break;
-
-            for (int x = parent_block.x; x < parent_block.x_end; ++x) {
-                int x_off = x - parent_block.x;
-                int x_end = x_off + width;
-                if (x_end > parent_x_end) break;
-
-                if (window_is_all(mode, z_off, z_end, y_off, y_end, x_off, x_end) &&
-                    window_is_all_uncompressed(z_off, z_end, y_off, y_end, x_off, x_end)) {
-
-                    Block b(x, y, z, width, height, depth, mode, x_off, y_off, z_off);
-                    grow_block(b, b);
-                    mark_compressed(z_off, z_off+b.depth, y_off, y_off+b.height, x_off, x_off+b.width, 1);
-                    return b;
-                }
-            }
+    int& cursor = fit_cursor[slot];
+    while (cursor < total) {
+        int z = cursor / plane, y = (cursor / pw) % ph, x = cursor % pw;
+        int hit = x + row_find_match(&model.at(z, y, x), pw - x, mode);
+        if (hit < pw && !compressed.test(z, y, hit)) {
+            cursor += hit - x;
+            break;
         }
+        cursor += (hit < pw ? hit + 1 : pw) - x;
     }
 
-    if (width <= 1 || height <= 1 || depth <= 1) {
-        throw std::runtime_error("No fitting block found at minimal size.");
+    int best = -1, best_size = 0;
+    for (int i = cursor; i < total; ++i) {
+        int size = cache[i];
+        if (size <= best_size) continue;
+
+        int z = i / plane, y = (i / pw) % ph, x = i % pw;
+        while (size > 0 && !(window_is_all(mode, z, z + size, y, y + size, x, x + size) &&
+                             window_is_all_uncompressed(z, z + size, y, y + size, x, x + size)))
+            --size;
+        STATS_COUNT(fit_shrinks, cache[i] - size);
+        cache[i] = size;
+
+        if (size > best_size) {
+            best_size = size;
+            best = i;
+            if (best_size == cube_size) break;
+        }
     }
-    return fit_block(mode, width - 1, height - 1, depth - 1);
+
+    if (best < 0) throw std::runtime_error("No fitting block found at minimal size.");
+
+    int z_off = best / plane, y_off = (best / pw) % ph, x_off = best % pw;
+    Block b(parent_block.x + x_off, parent_block.y + y_off, parent_block.z + z_off,
+            best_size, best_size, best_size, mode, x_off, y_off, z_off);
+    if (strategy == GrowthStrategy::LargestBox)
+        grow_largest_box(b);
+    else
+        grow_block(b);
+    mark_compressed(mode, z_off, z_off + b.depth, y_off, y_off + b.height, x_off, x_off + b.width);
+    return b;
 }
 
 bool BlockGrowth::window_is_all(char val,
                                 int z0, int z1, int y0, int y1, int x0, int x1) const {
-    for (int z = z0; z < z1; ++z)
-        for (int y = y0; y < y1; ++y)
-            for (int x = x0; x < x1; ++x)
-                if (model.at(z, y, x) != val) return false;
-    return true;
+    STATS_COUNT(window_checks, 1);
+    int slot = tag_slot[static_cast<unsigned char>(val)];
+    if (slot < 0) return false;
+    int volume = (z1 - z0) * (y1 - y0) * (x1 - x0);
+    return tag_sums[slot].sum(z0, z1, y0, y1, x0, x1) == volume;
 }
 
 bool BlockGrowth::window_is_all_uncompressed(int z0, int z1, int y0, int y1, int x0, int x1) const {
-    for (int z = z0; z < z1; ++z)
-        for (int y = y0; y < y1; ++y)
-            for (int x = x0; x < x1; ++x)
-                if (compressed.at(z, y, x) != 0) return false;
-    return true;
+    STATS_COUNT(window_checks, 1);
+    return !compressed.any(z0, z1, y0, y1, x0, x1);
 }
 
-void BlockGrowth::mark_compressed(int z0, int z1, int y0, int y1, int x0, int x1, char v) {
-    for (int z = z0; z < z1; ++z)
-        for (int y = y0; y < y1; ++y)
-            for (int x = x0; x < x1; ++x)
-                compressed.at(z, y, x) = v;
+// Marks an uncompressed window of 'tag' cells as compressed in the mask and
+// the remaining-cell counters
+void BlockGrowth::mark_compressed(char tag, int z0, int z1, int y0, int y1, int x0, int x1) {
+    int volume = (z1 - z0) * (y1 - y0) * (x1 - x0);
+    compressed.set_window(z0, z1, y0, y1, x0, x1);
+    remaining_by_slot[tag_slot[static_cast<unsigned char>(tag)]] -= volume;
+    remaining -= volume;
 }
 
-void BlockGrowth::grow_block(Block& current, Block& best_block) {
-    Block b = current;
+// Greedy growth, one layer at a time. The original recursive search called
+// itself on every feasible face but, because 'current' and 'best_block' were
+// the same object, each level's result was overwritten by the last feasible
+// face in +X, +Y, +Z order. Trying +Z, then +Y, then +X and committing to the
+// first feasible one produces exactly the same block without the exponential
+// re-exploration or per-level Block copies.
+void BlockGrowth::grow_block(Block& b) {
+    int x = b.x_offset, y = b.y_offset, z = b.z_offset;
+
+    while (true) {
+        STATS_COUNT(grow_steps, 1);
+        int x_end = x + b.width;
+        int y_end = y + b.height;
+        int z_end = z + b.depth;
 
+        if (z_end < parent_z_end && window_is_all(b.tag, z_end, z_end + 1, y, y_end, x, x_end) &&
+            window_is_all_uncompressed(z_end, z_end + 1, y, y_end, x, x_end)) {
+            b.set_depth(b.depth + 1);
+        } else if (y_end < parent_y_end && window_is_all(b.tag, z, z_end, y_end, y_end + 1, x, x_end) &&
+                   window_is_all_uncompressed(z, z_end, y_end, y_end + 1, x, x_end)) {
+            b.set_height(b.height + 1);
+        } else if (x_end < parent_x_end && window_is_all(b.tag, z, z_end, y, y_end, x_end, x_end + 1) &&
+                   window_is_all_uncompressed(z, z_end, y, y_end, x_end, x_end + 1)) {
+            b.set_width(b.width + 1);
+        } else {
+            return;
+        }
+    }
+}
+
+// Largest box of uncompressed b.tag cells whose minimum corner is b's origin.
+// For each plane z, row y gets the length of its uncompressed same-tag run
+// starting at x; 'run' keeps the minimum of those lengths over the planes
+// taken so far, so the widest box of a given depth and height is the prefix
+// minimum of 'run' over its rows. A zero run closes off every row below it
+// (and a zero first row every plane behind it), which bounds the scan to the
+// staircase reachable from the origin.
+void BlockGrowth::grow_largest_box(Block& b) {
     int x = b.x_offset, y = b.y_offset, z = b.z_offset;
-    int x_end = x + b.width;
-    int y_end = y + b.height;
-    int z_end = z + b.depth;
-
-    // Try +X growth
-    if (x_end < parent_x_end) {
-        bool ok = true;
-        for (int zz = z; zz < z_end && ok; ++zz)
-            for (int yy = y; yy < y_end && ok; ++yy) {
-                if (model.at(zz, yy, x_end) != b.tag || compressed.at(zz, yy, x_end) != 0) ok = false;
+    int rows = parent_y_end - y;
+
+    std::vector<int>& run = scratch.runs;
+    run.assign(rows, parent_x_end - x);
+    int best_w = b.width, best_h = b.height, best_d = b.depth;
+    long long best_volume = static_cast<long long>(best_w) * best_h * best_d;
+
+    for (int zz = z; zz < parent_z_end && run[0] > 0; ++zz) {
+        int width = run[0];
+        for (int r = 0; r < rows; ++r) {
+            int yy = y + r;
+            int limit = compressed.row_find_set(zz, yy, x, x + run[r]) - x;
+            int len = row_find_mismatch(&model.at(zz, yy, x), limit, b.tag);
+            run[r] = len;
+            width = std::min(width, len);
+            if (width == 0) break;
+
+            long long volume = static_cast<long long>(width) * (r + 1) * (zz - z + 1);
+            if (volume > best_volume) {
+                best_volume = volume;
+                best_w = width;
+                best_h = r + 1;
+                best_d = zz - z + 1;
             }
-        if (ok) { b.set_width(b.width + 1); current = b; grow_block(current, best_block); if (current.volume > best_block.volume) best_block = current; b.set_width(b.width - 1); }
+        }
     }
 
-    // Try +Y growth
-    if (y_end < parent_y_end) {
-        bool ok = true;
-        for (int zz = z; zz < z_end && ok; ++zz)
-            for (int xx = x; xx < x_end && ok; ++xx) {
-                if (model.at(zz, y_end, xx) != b.tag || compressed.at(zz, y_end, xx) != 0) ok = false;
+    b.set_width(best_w);
+    b.set_height(best_h);
+    b.set_depth(best_d);
+}
+
+// Scanline strategy. Each row is cut into runs of one tag; a run with the same
+// columns and tag as a rectangle open on the row above extends it downwards,
+// otherwise it starts a new rectangle. A slice's finished rectangles then
+// extend the boxes open from the slice before when their footprint and tag
+// match exactly. Rectangles and boxes are kept sorted by origin, so matching
+// is a linear merge and no cell is visited more than once.
+void BlockGrowth::run_scanline(BlockSink& out) {
+    std::vector<Block>& rows = scratch.rows;          // rectangles open on the previous row
+    std::vector<Block>& next_rows = scratch.next_rows;
+    std::vector<Block>& rects = scratch.rects;        // rectangles finished in this slice
+    std::vector<Block>& boxes = scratch.boxes;        // boxes open from the previous slice
+    std::vector<Block>& next_boxes = scratch.next_boxes;
+    int pw = parent_block.width;
+    boxes.clear();
+
+    // Rectangles and boxes hold parent-local coordinates until emitted
+    auto by_origin = [](const Block& a, const Block& b) { return a.y != b.y ? a.y < b.y : a.x < b.x; };
+    auto emit = [&](const Block& b) {
+        out.emit(Block(parent_block.x + b.x, parent_block.y + b.y, parent_block.z + b.z, b.width, b.height, b.depth,
+                       b.tag, b.x, b.y, b.z));
+    };
+
+    for (int z = 0; z < parent_block.depth; ++z) {
+        rows.clear();
+        rects.clear();
+        for (int y = 0; y < parent_block.height; ++y) {
+            const char* row = &model.at(z, y, 0);
+            next_rows.clear();
+            std::size_t open = 0;
+            for (int x = 0; x < pw;) {
+                char tag = row[x];
+                int x_end = x + row_find_mismatch(row + x, pw - x, tag);
+                while (open < rows.size() && rows[open].x < x)
+                    rects.push_back(rows[open++]);
+
+                if (open < rows.size() && rows[open].x == x && rows[open].x_end == x_end && rows[open].tag == tag) {
+                    Block r = rows[open++];
+                    r.set_height(r.height + 1);
+                    next_rows.push_back(r);
+                } else {
+                    next_rows.emplace_back(x, y, z, x_end - x, 1, 1, tag);
+                }
+                x = x_end;
             }
-        if (ok) { b.set_height(b.height + 1); current = b; grow_block(current, best_block); if (current.volume > best_block.volume) best_block = current; b.set_height(b.height - 1); }
-    }
+            while (open < rows.size())
+                rects.push_back(rows[open++]);
+            rows.swap(next_rows);
+        }
+        rects.insert(rects.end(), rows.begin(), rows.end());
+        std::sort(rects.begin(), rects.end(), by_origin);
 
-    // Try +Z growth
-    if (z_end < parent_z_end) {
-        bool ok = true;
-        for (int yy = y; yy < y_end && ok; ++yy)
-            for (int xx = x; xx < x_end && ok; ++xx) {
-                if (model.at(z_end, yy, xx) != b.tag || compressed.at(z_end, yy, xx) != 0) ok = false;
+        // Extrude: boxes and rectangles are both sorted by origin
+        next_boxes.clear();
+        std::size_t b = 0;
+        for (const Block& r : rects) {
+            while (b < boxes.size() && by_origin(boxes[b], r))
+                emit(boxes[b++]);
+            if (b < boxes.size() && boxes[b].x == r.x && boxes[b].y == r.y && boxes[b].width == r.width &&
+                boxes[b].height == r.height && boxes[b].tag == r.tag) {
+                Block box = boxes[b++];
+                box.set_depth(box.depth + 1);
+                next_boxes.push_back(box);
+            } else {
+                next_boxes.push_back(r);
             }
-        if (ok) { b.set_depth(b.depth + 1); current = b; grow_block(current, best_block); if (current.volume > best_block.volume) best_block = current; b.set_depth(b.depth - 1); }
+        }
+        while (b < boxes.size())
+            emit(boxes[b++]);
+        boxes.swap(next_boxes);
     }
 
-    if (b.volume > best_block.volume)
-        best_block = b;
-}
\ No newline at end of file
+    for (const Block& box : boxes)
+        emit(box);
+}
+
+// Octree strategy: a window of one tag is emitted whole, anything else is
+// split at the midpoint of every axis longer than one cell and the parts are
+// handled in z, y, x order. Uniformity is one summed-volume lookup.
+void BlockGrowth::run_octree(int z0, int z1, int y0, int y1, int x0, int x1, BlockSink& out) {
+    char tag = model.at(z0, y0, x0);
+    if (window_is_all(tag, z0, z1, y0, y1, x0, x1)) {
+        out.emit(Block(parent_block.x + x0, parent_block.y + y0, parent_block.z + z0, x1 - x0, y1 - y0, z1 - z0, tag,
+                       x0, y0, z0));
+        return;
+    }
+
+    int zs[3] = {z0, z1 - z0 > 1 ? (z0 + z1) / 2 : z1, z1};
+    int ys[3] = {y0, y1 - y0 > 1 ? (y0 + y1) / 2 : y1, y1};
+    int xs[3] = {x0, x1 - x0 > 1 ? (x0 + x1) / 2 : x1, x1};
+    for (int i = 0; i < 2; ++i)
+        for (int j = 0; j < 2; ++j)
+            for (int k = 0; k < 2; ++k)
+                if (zs[i] < zs[i + 1] && ys[j] < ys[j + 1] && xs[k] < xs[k + 1])
+                    run_octree(zs[i], zs[i + 1], ys[j], ys[j + 1], xs[k], xs[k + 1], out);
+}
+
+// BlockGrowth working buffers, one set per thread, reused across parent blocks
+static GrowthScratch& thread_scratch() {
+    thread_local GrowthScratch scratch;
+    return scratch;
+}
+
+void grow_parent_block(const Flat3DView<const char>& model, const Block& parent, GrowthStrategy strategy,
+                       BlockSink& out) {
+    if (strategy == GrowthStrategy::Greedy && run_fixed_growth(model, parent, out)) {
+        STATS_COUNT(parents_fixed, 1);
+        return;
+    }
+
+    STATS_COUNT(parents_grown, 1);
+    BlockGrowth growth(model, strategy, &thread_scratch());
+    growth.run(parent, out);
+}
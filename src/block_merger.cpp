@@ -0,0 +1,103 @@
+#include "block_merger.h"
+#include <algorithm>
+#include <tuple>
+
+BlockMerger::BlockMerger(MergeMode mode, BlockSink& out) : mode(mode), out(out) {}
+
+long BlockMerger::find_continued(const Block& b) const {
+    if (b.z != frontier_end) return -1;
+    auto it = frontier_at.find(key(b));
+    if (it == frontier_at.end()) return -1;
+    const Block& f = frontier[it->second];
+    if (f.width != b.width || f.height != b.height || f.tag != b.tag) return -1;
+    return static_cast<long>(it->second);
+}
+
+void BlockMerger::add_slab(std::vector<Block>& blocks, int end_slice) {
+    if (mode == MergeMode::XYZ) {
+        while (merge_xy(blocks)) {
+        }
+    }
+
+    // Frontier blocks nothing continues are complete; emit them first so the
+    // output stays roughly in z order
+    continued.assign(frontier.size(), 0);
+    for (const Block& b : blocks) {
+        long f = find_continued(b);
+        if (f >= 0) continued[f] = 1;
+    }
+    for (std::size_t i = 0; i < frontier.size(); ++i)
+        if (!continued[i]) out.emit(frontier[i]);
+
+    next_frontier.clear();
+    for (const Block& b : blocks) {
+        Block merged = b;
+        long f = find_continued(b);
+        if (f >= 0) {
+            merged = frontier[f];
+            merged.set_depth(merged.depth + b.depth);
+        }
+
+        if (merged.z_end == end_slice)
+            next_frontier.push_back(merged);
+        else
+            out.emit(merged);
+    }
+
+    frontier.swap(next_frontier);
+    frontier_at.clear();
+    for (std::size_t i = 0; i < frontier.size(); ++i)
+        frontier_at[key(frontier[i])] = i;
+    frontier_end = end_slice;
+}
+
+void BlockMerger::finish() {
+    for (const Block& b : frontier)
+        out.emit(b);
+    frontier.clear();
+    frontier_at.clear();
+    frontier_end = -1;
+}
+
+// One sweep joining x neighbours, then one joining y neighbours, each over the
+// blocks sorted so that joinable pairs are adjacent. True if anything merged.
+bool BlockMerger::merge_xy(std::vector<Block>& blocks) {
+    bool merged = false;
+    auto sweep = [&](auto order, auto joinable, auto join) {
+        std::sort(blocks.begin(), blocks.end(), order);
+        std::size_t kept = 0;
+        for (std::size_t i = 0; i < blocks.size(); ++i) {
+            if (kept > 0 && joinable(blocks[kept - 1], blocks[i])) {
+                join(blocks[kept - 1], blocks[i]);
+                merged = true;
+            } else {
+                blocks[kept++] = blocks[i];
+            }
+        }
+        blocks.erase(blocks.begin() + static_cast<std::ptrdiff_t>(kept), blocks.end());
+    };
+
+    sweep(
+        [](const Block& a, const Block& b) {
+            return std::make_tuple(a.z, a.depth, a.y, a.height, a.tag, a.x) <
+                   std::make_tuple(b.z, b.depth, b.y, b.height, b.tag, b.x);
+        },
+        [](const Block& a, const Block& b) {
+            return a.z == b.z && a.depth == b.depth && a.y == b.y && a.height == b.height && a.tag == b.tag &&
+                   a.x_end == b.x;
+        },
+        [](Block& a, const Block& b) { a.set_width(a.width + b.width); });
+
+    sweep(
+        [](const Block& a, const Block& b) {
+            return std::make_tuple(a.z, a.depth, a.x, a.width, a.tag, a.y) <
+                   std::make_tuple(b.z, b.depth, b.x, b.width, b.tag, b.y);
+        },
+        [](const Block& a, const Block& b) {
+            return a.z == b.z && a.depth == b.depth && a.x == b.x && a.width == b.width && a.tag == b.tag &&
+                   a.y_end == b.y;
+        },
+        [](Block& a, const Block& b) { a.set_height(a.height + b.height); });
+
+    return merged;
+}
@@ -1,7 +1,14 @@
 #include "block_model.h"
+#include "binary_format.h"
+#include "blocking_queue.h"
+#include "row_kernels.h"
 #include <algorithm>
 #include <cctype>
+#include <cstring>
+#include <exception>
+#include <filesystem>
 #include <iostream>
+#include <mutex>
 #include <stdexcept>
 #include <vector>
 
@@ -17,13 +24,56 @@ BlockModel::BlockModel() {
 
 void BlockModel::set_num_threads(unsigned int threads) {
     num_threads = std::max(1u, threads); // Ensure at least 1 thread
+    pool.reset();
+}
+
+void BlockModel::set_growth_strategy(GrowthStrategy strategy) {
+    growth_strategy = strategy;
+}
+
+void BlockModel::set_output_format(OutputFormat format) {
+    output_format = format;
+    slabs.clear();
+}
+
+void BlockModel::set_slab_encoding(SlabEncoding encoding) {
+    slab_encoding = encoding;
+}
+
+void BlockModel::set_merge_mode(MergeMode mode) {
+    merge_mode = mode;
+}
+
+void BlockModel::set_collect_stats(bool enabled) {
+#if BLOCK_STATS
+    collect_stats = enabled;
+#else
+    if (enabled) throw std::runtime_error("Statistics were compiled out (rebuild with STATS=1).");
+#endif
+}
+
+void BlockModel::set_output_file(const string& path) {
+    output_path = path;
+}
+
+void BlockModel::set_checkpoint(const string& path, int every_slabs) {
+    if (every_slabs < 1) throw std::runtime_error("Checkpoint interval must be at least one slab.");
+    checkpoint_path = path;
+    checkpoint_every = every_slabs;
+}
+
+void BlockModel::set_resume(bool enabled) {
+    resume = enabled;
 }
 
 void BlockModel::read_specification() {
+    if (collect_stats) header_start = std::chrono::steady_clock::now();
     string line;
     getline_strict(line);
     vector<int> vals = split_csv_ints(line);
     if (vals.size() != 6) throw std::runtime_error("Invalid specification line (need 6 ints).");
+    for (int v : vals)
+        if (v <= 0) throw std::runtime_error("Invalid specification line (dimensions must be positive).");
     x_count  = vals[0];
     y_count  = vals[1];
     z_count  = vals[2];
@@ -36,8 +86,7 @@ void BlockModel::read_tag_table() {
     tag_table.clear();
     string line;
     while (true) {
-        if (!std::getline(std::cin, line)) { line.clear(); }
-        if (!line.empty() && line.back() == '\r') line.pop_back();
+        getline_strict(line);
         if (is_empty_line(line)) break;
 
         auto pos = line.find(", ");
@@ -48,40 +97,358 @@ void BlockModel::read_tag_table() {
         string label = line.substr(pos + 2);
         tag_table[tag] = label;
     }
+    labels = LabelTable(tag_table);
+    tag_ids = TagIds(tag_table);
+    if (collect_stats) stats.run.header_seconds = Stats::seconds_since(header_start);
+}
+
+void BlockModel::set_input_file(const string& path) {
+    mapped = std::make_unique<MappedFile>(path);
+    reader.reset();
+}
+
+// Name of a strategy in the statistics report and checkpoints (as given to --growth)
+static const char* strategy_name(GrowthStrategy strategy) {
+    switch (strategy) {
+    case GrowthStrategy::LargestBox:
+        return "largest";
+    case GrowthStrategy::Scanline:
+        return "scanline";
+    case GrowthStrategy::Octree:
+        return "octree";
+    default:
+        return "greedy";
+    }
+}
+
+// Names of the output format and slab encoding (as given to --format and --slabs)
+static const char* format_name(OutputFormat format) {
+    return format == OutputFormat::Binary ? "binary" : "text";
+}
+
+static const char* encoding_name(SlabEncoding encoding) {
+    switch (encoding) {
+    case SlabEncoding::Rle:
+        return "rle";
+    case SlabEncoding::Packed:
+        return "packed";
+    default:
+        return "dense";
+    }
 }
 
 void BlockModel::read_model() {
-    model = Flat3D<char>(parent_z, y_count, x_count, '\0');
+    auto started = std::chrono::steady_clock::now();
+    Stats::enabled = collect_stats;
+    if (collect_stats) {
+        Stats::reset();
+        stats.run.x_count = x_count;
+        stats.run.y_count = y_count;
+        stats.run.z_count = z_count;
+        stats.run.parent_x = parent_x;
+        stats.run.parent_y = parent_y;
+        stats.run.parent_z = parent_z;
+        stats.run.threads = num_threads;
+        stats.run.strategy = strategy_name(growth_strategy);
+    }
 
-    int top_slice = 0;
-    int n_slices = parent_z;
+    if (num_threads > 1 && !pool) pool = std::make_unique<ThreadPool>(num_threads);
+    open_output();
+    if (mapped) detect_mapped_layout();
+    if (output_format == OutputFormat::Binary && first_slice == 0)
+        write_binary_header(*out, BinaryHeader({x_count, y_count, z_count, parent_x, parent_y, parent_z}, tag_table));
 
-    string line;
-    for (int z = 0; z < z_count; ++z) {
+    if (merge_mode != MergeMode::None) {
+        merged_output = make_block_buffer();
+        merger = std::make_unique<BlockMerger>(merge_mode, *merged_output);
+    }
+
+    if (pool && z_count > parent_z) {
+        run_pipeline();
+    } else {
+        if (slabs.empty()) slabs.emplace_back();
+        for (int top_slice = first_slice; top_slice < z_count; top_slice += parent_z) {
+            load_slab(slabs[0], top_slice);
+            compress_slices(slabs[0]);
+            write_slab_output(slabs[0]);
+        }
+    }
+
+    if (merger) {
+        merger->finish();
+        merged_output->write_to(*out);
+        merged_output->clear();
+        merger.reset();
+    }
+
+    out->flush();
+    if (output_file.is_open()) {
+        if (!output_file) throw std::runtime_error("Cannot write " + output_path);
+        output_file.close();
+    }
+    if (collect_stats) {
+        stats.run.wall_seconds = Stats::seconds_since(started);
+        stats.write_json(std::cerr, Stats::total());
+        Stats::enabled = false;
+    }
+}
+
+// A reader thread loads each slab and queues its parent blocks on the pool
+// straight away, so blocks from every slab in flight are balanced across the
+// pool's threads. The calling thread writes the slabs in order, running queued
+// parent blocks itself while it waits for the next slab to finish. Slabs
+// circulate through two queues, so no more than PIPELINE_DEPTH are ever
+// allocated. The first exception from any stage stops the pipeline and is
+// rethrown here once no task refers to a slab any more.
+void BlockModel::run_pipeline() {
+    while (slabs.size() < PIPELINE_DEPTH)
+        slabs.emplace_back();
+
+    BlockingQueue<Slab*> free_slabs, loaded;
+    for (Slab& slab : slabs)
+        free_slabs.push(&slab);
+
+    std::mutex error_mtx;
+    std::exception_ptr error;
+    auto fail = [&] {
+        {
+            std::lock_guard<std::mutex> lock(error_mtx);
+            if (!error) error = std::current_exception();
+        }
+        free_slabs.close();
+        loaded.close();
+    };
+
+    std::thread reader([&] {
+        try {
+            Slab* slab;
+            for (int top_slice = first_slice; top_slice < z_count && free_slabs.pop(slab); top_slice += parent_z) {
+                load_slab(*slab, top_slice);
+                prepare_slab(*slab);
+                submit_slab(*slab);
+                loaded.push(slab);
+            }
+            loaded.close();
+        } catch (...) {
+            fail();
+        }
+    });
+
+    try {
+        Slab* slab;
+        while (loaded.pop(slab)) {
+            pool->wait(slab->tasks);
+            write_slab_output(*slab);
+            free_slabs.push(slab);
+        }
+    } catch (...) {
+        fail();
+    }
+
+    reader.join();
+    for (Slab& slab : slabs) {
+        try {
+            pool->wait(slab.tasks);
+        } catch (...) {
+            // only the first error is reported
+        }
+    }
+    if (error) std::rethrow_exception(error);
+}
+
+void BlockModel::load_slab(Slab& slab, int top_slice) {
+#if BLOCK_STATS
+    if (collect_stats) {
+        auto start = std::chrono::steady_clock::now();
+        read_slab_rows(slab, top_slice);
+        slab.input_end = input().offset();
+        slab.stats = SlabStats();
+        slab.stats.top_slice = slab.top_slice;
+        slab.stats.n_slices = slab.n_slices;
+        slab.stats.read_seconds = Stats::seconds_since(start);
+        return;
+    }
+#endif
+    read_slab_rows(slab, top_slice);
+    slab.input_end = input().offset();
+}
+
+void BlockModel::read_slab_rows(Slab& slab, int top_slice) {
+    slab.top_slice = top_slice;
+    slab.n_slices = std::min(parent_z, z_count - top_slice);
+
+    slab.parents.reset(spec(), top_slice, slab.n_slices);
+
+    slab.encoding = SlabEncoding::Dense;
+    if (map_slab(top_slice, slab.n_slices, slab.view)) {
+        for (int z = 0; z < slab.n_slices; ++z)
+            for (int y = 0; y < y_count; ++y)
+                slab.parents.summarize_row(z, y, &slab.view.at(z, y, 0));
+        return;
+    }
+
+    if (slab_encoding == SlabEncoding::Rle) {
+        read_slab_encoded(slab);
+        return;
+    }
+    if (slab_encoding == SlabEncoding::Packed && tag_ids.count() <= PackedSlab::MAX_TAGS) {
+        read_slab_packed(slab);
+        return;
+    }
+
+    size_rows(slab);
+    slab.view = read_slab(slab);
+}
+
+void BlockModel::size_rows(Slab& slab) {
+    if (slab.rows.depth != parent_z || slab.rows.height != y_count || slab.rows.width != x_count)
+        slab.rows = Flat3D<char>(parent_z, y_count, x_count, '\0');
+}
+
+Flat3DView<const char> BlockModel::read_slab(Slab& slab) {
+    // Rows are copied straight from the reader's buffer into the slab and
+    // summarised while they are still in cache
+    LineReader& in = input();
+    const char* line;
+    std::size_t len;
+    for (int z = 0; z < slab.n_slices; ++z) {
         for (int y = 0; y < y_count; ++y) {
-            getline_strict(line);
-            if ((int)line.size() < x_count)
+            in.next_line(line, len);
+            if (len < static_cast<std::size_t>(x_count))
                 throw std::runtime_error("Model row shorter than x_count.");
-            for (int x = 0; x < x_count; ++x) {
-                model.at(z % parent_z, y, x) = line[x];
-            }
+            std::memcpy(&slab.rows.at(z, y, 0), line, x_count);
+            slab.parents.summarize_row(z, y, line);
+        }
+
+        if (slab.top_slice + z < z_count - 1) in.next_line(line, len); // blank separator
+    }
+    return Flat3DView<const char>(slab.rows).sub(0, slab.n_slices, 0, y_count, 0, x_count);
+}
+
+// Encodes rows as they are parsed; no dense copy of the slab is kept. The
+// uniform-tag summary is a window query over the runs of each parent.
+void BlockModel::read_slab_encoded(Slab& slab) {
+    slab.encoding = SlabEncoding::Rle;
+    slab.view = Flat3DView<const char>();
+    slab.runs.reset(slab.n_slices, y_count, x_count);
+
+    LineReader& in = input();
+    const char* line;
+    std::size_t len;
+    for (int z = 0; z < slab.n_slices; ++z) {
+        for (int y = 0; y < y_count; ++y) {
+            in.next_line(line, len);
+            if (len < static_cast<std::size_t>(x_count))
+                throw std::runtime_error("Model row shorter than x_count.");
+            slab.runs.append_row(line);
         }
 
-        if ((z + 1) % parent_z == 0) {
-            compress_slices(top_slice, n_slices);
-            top_slice = z + 1;
+        if (slab.top_slice + z < z_count - 1) in.next_line(line, len); // blank separator
+    }
+
+    for (std::size_t i = 0; i < slab.parents.size(); ++i) {
+        const Block& p = slab.parents[i];
+        char tag = slab.runs.tag_at(0, p.y, p.x);
+        slab.parents.set_summary(i, tag, slab.runs.window_is(tag, 0, slab.n_slices, p.y, p.y_end, p.x, p.x_end));
+    }
+}
+
+// Packs rows into tag ids as they are parsed, summarising each while it is
+// still in cache, as read_slab does. A tag outside the tag table has no id,
+// so a slab with one is unpacked and kept dense, as the other layouts accept
+// it too.
+void BlockModel::read_slab_packed(Slab& slab) {
+    slab.encoding = SlabEncoding::Packed;
+    slab.view = Flat3DView<const char>();
+    slab.packed.set_tags(tag_ids);
+    slab.packed.reset(slab.n_slices, y_count, x_count);
+
+    LineReader& in = input();
+    const char* line;
+    std::size_t len;
+    for (int z = 0; z < slab.n_slices; ++z) {
+        for (int y = 0; y < y_count; ++y) {
+            in.next_line(line, len);
+            if (len < static_cast<std::size_t>(x_count))
+                throw std::runtime_error("Model row shorter than x_count.");
+            if (slab.encoding == SlabEncoding::Packed && !slab.packed.append_row(line)) {
+                size_rows(slab);
+                for (int pz = 0; pz <= z; ++pz)
+                    for (int py = 0; py < (pz < z ? y_count : y); ++py)
+                        slab.packed.decode(pz, py, 0, x_count, &slab.rows.at(pz, py, 0));
+                slab.encoding = SlabEncoding::Dense;
+            }
+            if (slab.encoding == SlabEncoding::Dense) std::memcpy(&slab.rows.at(z, y, 0), line, x_count);
+            slab.parents.summarize_row(z, y, line);
         }
 
-        if (z < z_count - 1) {
-            string sep;
-            getline_strict(sep);
+        if (slab.top_slice + z < z_count - 1) in.next_line(line, len); // blank separator
+    }
+    if (slab.encoding == SlabEncoding::Dense)
+        slab.view = Flat3DView<const char>(slab.rows).sub(0, slab.n_slices, 0, y_count, 0, x_count);
+}
+
+// Rows of a mapped file can be used in place when every row is exactly
+// x_count chars and every line ends the same way; the first row read (the
+// model's, or the resumed slab's) decides LF or CRLF and map_slab checks
+// each slab against that before using it, starting wherever the reader is. Any
+// slab the line reader would read differently is copied instead, so both
+// paths accept exactly the same input.
+void BlockModel::detect_mapped_layout() {
+    mapped_eol = 0;
+
+    const char* data = mapped->data();
+    std::size_t size = mapped->size();
+    std::size_t row_end = input().offset() + x_count;
+    if (row_end < size && data[row_end] == '\n')
+        mapped_eol = 1;
+    else if (row_end + 1 < size && data[row_end] == '\r' && data[row_end + 1] == '\n')
+        mapped_eol = 2;
+}
+
+bool BlockModel::map_slab(int top_slice, int n_slices, Flat3DView<const char>& slab) {
+    if (!mapped || mapped_eol == 0) return false;
+
+    const char* data = mapped->data();
+    std::size_t size = mapped->size();
+    std::size_t eol = static_cast<std::size_t>(mapped_eol);
+    std::size_t row_stride = x_count + eol;
+    std::size_t plane_stride = y_count * row_stride + eol;
+    std::size_t start = input().offset();
+
+    // True if a line terminator (or the end of the file) starts at p
+    auto line_ends_at = [&](std::size_t p) {
+        if (p == size) return true;
+        if (p + eol > size || data[p + eol - 1] != '\n') return false;
+        return eol == 1 || data[p] == '\r';
+    };
+
+    // True if the row at p has no line break inside it and no '\r' at its
+    // end, which the line reader would strip as part of a CRLF
+    auto row_is_plain = [&](std::size_t p) {
+        return !std::memchr(data + p, '\n', x_count) && (x_count == 0 || data[p + x_count - 1] != '\r');
+    };
+
+    bool uniform = true;
+    for (int z = 0; z < n_slices && uniform; ++z) {
+        std::size_t plane = start + z * plane_stride;
+        for (int y = 0; y < y_count && uniform; ++y) {
+            std::size_t row = plane + y * row_stride;
+            uniform = line_ends_at(row + x_count) && row_is_plain(row);
         }
+        if (uniform && top_slice + z < z_count - 1) uniform = line_ends_at(plane + y_count * row_stride);
     }
 
-    if (z_count % parent_z != 0) {
-        n_slices = z_count % parent_z;
-        compress_slices(top_slice, n_slices);
+    if (!uniform) {
+        // Fall back to copying from here on; the reader is still at the slab
+        mapped_eol = 0;
+        return false;
     }
+
+    input().seek(std::min(size, start + n_slices * plane_stride));
+    slab = Flat3DView<const char>(data + start, n_slices, y_count, x_count, static_cast<std::ptrdiff_t>(row_stride),
+                                  static_cast<std::ptrdiff_t>(plane_stride));
+    return true;
 }
 
 bool BlockModel::is_empty_line(const string& s) {
@@ -90,50 +457,280 @@ bool BlockModel::is_empty_line(const string& s) {
     return false;
 }
 
+LineReader& BlockModel::input() {
+    if (!reader) {
+        if (mapped)
+            reader = std::make_unique<LineReader>(mapped->data(), mapped->size());
+        else
+            reader = std::make_unique<LineReader>(std::cin);
+    }
+    return *reader;
+}
+
 void BlockModel::getline_strict(string& out) {
-    if (!std::getline(std::cin, out)) out.clear();
-    if (!out.empty() && out.back() == '\r') out.pop_back();
+    const char* line;
+    std::size_t len;
+    input().next_line(line, len);
+    out.assign(line, len);
 }
 
+// Comma-separated ints; whitespace is ignored and an empty field reads as 0
 vector<int> BlockModel::split_csv_ints(const string& line) {
     vector<int> vals;
-    string cur;
+    long long cur = 0;
+    bool negative = false, has_digits = false, has_field = false;
     for (char c : line) {
         if (c == ',') {
-            if (!cur.empty()) { vals.push_back(std::stoi(cur)); cur.clear(); }
-            else { vals.push_back(0); }
+            vals.push_back(static_cast<int>(negative ? -cur : cur));
+            cur = 0;
+            negative = has_digits = has_field = false;
+        } else if (c >= '0' && c <= '9') {
+            cur = cur * 10 + (c - '0');
+            if (cur > (negative ? 2147483648LL : 2147483647LL)) throw std::runtime_error("Integer out of range in line: " + line);
+            has_digits = has_field = true;
+        } else if ((c == '-' || c == '+') && !has_field) {
+            negative = c == '-';
+            has_field = true;
         } else if (!std::isspace(static_cast<unsigned char>(c))) {
-            cur.push_back(c);
+            throw std::runtime_error("Invalid integer in line: " + line);
         }
     }
-    if (!cur.empty()) vals.push_back(std::stoi(cur));
+    if (has_field && !has_digits) throw std::runtime_error("Invalid integer in line: " + line);
+    if (has_digits) vals.push_back(static_cast<int>(negative ? -cur : cur));
     return vals;
 }
 
-Flat3D<char> BlockModel::slice_model(const Flat3D<char>& src,
-                                     int depth, int y0, int y1, int x0, int x1) {
-    Flat3D<char> out(depth, y1 - y0, x1 - x0, '\0');
-    for (int z = 0; z < depth; ++z)
-        for (int y = y0; y < y1; ++y)
-            for (int x = x0; x < x1; ++x)
-                out.at(z, y - y0, x - x0) = src.at(z, y, x);
-    return out;
+Flat3DView<const char> BlockModel::slice_model(const Flat3DView<const char>& src,
+                                               int depth, int y0, int y1, int x0, int x1) {
+    return src.sub(0, depth, y0, y1, x0, x1);
+}
+
+// Dense copy of one parent block of an encoded slab, one per thread
+static Flat3D<char>& thread_parent_rows() {
+    thread_local Flat3D<char> rows;
+    return rows;
+}
+
+void BlockModel::compress_slices(Slab& slab) {
+    prepare_slab(slab);
+    if (pool) {
+        submit_slab(slab);
+        pool->wait(slab.tasks);
+        return;
+    }
+
+    for (std::size_t i = 0; i < slab.parents.size(); ++i)
+        compress_parent(slab, i, parent_sink(slab, 0));
+}
+
+// Sets up the output buffers of the slab's parent blocks
+void BlockModel::prepare_slab(Slab& slab) {
+    if (collect_stats) slab.parent_stats.assign(slab.parents.size(), ParentStats());
+    slab.n_output = pool ? slab.parents.run_count() : 1;
+    if (merger) {
+        if (slab.lists.size() < slab.n_output) slab.lists.resize(slab.n_output);
+        return;
+    }
+    while (slab.output.size() < slab.n_output)
+        slab.output.push_back(make_block_buffer());
+}
+
+std::unique_ptr<BlockBuffer> BlockModel::make_block_buffer() const {
+    if (output_format == OutputFormat::Binary) return std::make_unique<BinaryBlockBuffer>();
+    return std::make_unique<TextBlockBuffer>(labels);
+}
+
+BlockSink& BlockModel::parent_sink(Slab& slab, std::size_t i) {
+    if (merger) return slab.lists[i];
+    return *slab.output[i];
+}
+
+// Queues one pool task per run of parent blocks. Each compresses into its
+// own buffer; buffers are written in (y, x) order so the output matches the
+// serial path.
+void BlockModel::submit_slab(Slab& slab) {
+    for (std::size_t r = 0; r < slab.parents.run_count(); ++r)
+        pool->submit(slab.tasks, [this, &slab, r] {
+            BlockSink& out = parent_sink(slab, r);
+            for (std::size_t i = slab.parents.run_begin(r); i < slab.parents.run_begin(r + 1); ++i)
+                compress_parent(slab, i, out);
+        });
+}
+
+// Forwards blocks to another sink, counting them
+class CountingSink : public BlockSink {
+public:
+    explicit CountingSink(BlockSink& out) : out(out) {}
+
+    void emit(const Block& b) override {
+        ++blocks;
+        out.emit(b);
+    }
+
+    std::uint64_t blocks = 0;
+
+private:
+    BlockSink& out;
+};
+
+void BlockModel::compress_parent(Slab& slab, std::size_t i, BlockSink& out) {
+#if BLOCK_STATS
+    if (collect_stats) {
+        auto start = std::chrono::steady_clock::now();
+        CountingSink counted(out);
+        grow_parent(slab, i, counted);
+        slab.parent_stats[i].seconds = Stats::seconds_since(start);
+        slab.parent_stats[i].blocks = counted.blocks;
+        return;
+    }
+#endif
+    grow_parent(slab, i, out);
+}
+
+void BlockModel::grow_parent(const Slab& slab, std::size_t i, BlockSink& out) {
+    const Block& parentBlock = slab.parents[i];
+    bool uniform = slab.parents.uniform(i);
+    Flat3DView<const char> model_slices;
+    if (uniform) {
+        // A single tag compresses to the parent block itself; nothing to read
+    } else if (slab.encoding != SlabEncoding::Dense) {
+        // BlockGrowth scans dense rows, so a mixed parent is expanded into a
+        // parent-sized buffer (never the whole slab)
+        STATS_COUNT(parent_decodes, 1);
+        Flat3D<char>& rows = thread_parent_rows();
+        if (rows.depth != parentBlock.depth || rows.height != parentBlock.height || rows.width != parentBlock.width)
+            rows = Flat3D<char>(parentBlock.depth, parentBlock.height, parentBlock.width);
+        for (int z = 0; z < parentBlock.depth; ++z)
+            for (int y = 0; y < parentBlock.height; ++y)
+                if (slab.encoding == SlabEncoding::Rle)
+                    slab.runs.decode(z, parentBlock.y + y, parentBlock.x, parentBlock.x_end, &rows.at(z, y, 0));
+                else
+                    slab.packed.decode(z, parentBlock.y + y, parentBlock.x, parentBlock.x_end, &rows.at(z, y, 0));
+        model_slices = rows;
+    } else {
+        model_slices = slice_model(slab.view, parentBlock.depth, parentBlock.y, parentBlock.y_end, parentBlock.x,
+                                   parentBlock.x_end);
+    }
+    compress_parent_block(model_slices, parentBlock, uniform, growth_strategy, out);
+}
+
+void BlockModel::write_slab_output(Slab& slab) {
+#if BLOCK_STATS
+    if (collect_stats) {
+        auto start = std::chrono::steady_clock::now();
+        write_slab_blocks(slab);
+        slab.stats.write_seconds = Stats::seconds_since(start);
+        record_slab_stats(slab);
+    } else {
+        write_slab_blocks(slab);
+    }
+#else
+    write_slab_blocks(slab);
+#endif
+    if (!checkpoint_path.empty()) save_checkpoint(slab);
+}
+
+// Opens the output and, when resuming, restores the checkpointed position in
+// both files. Checkpoints need seekable files on both sides, and no merge
+// pass, whose open blocks would be lost between slabs.
+void BlockModel::open_output() {
+    out = &std::cout;
+    first_slice = 0;
+    if (resume && checkpoint_path.empty()) throw std::runtime_error("Resuming needs a checkpoint file.");
+    if (!checkpoint_path.empty()) {
+        if (!mapped || output_path.empty())
+            throw std::runtime_error("Checkpoints need an input file and an output file.");
+        if (merge_mode != MergeMode::None) throw std::runtime_error("Checkpoints cannot be combined with merging.");
+    }
+    if (output_path.empty()) return;
+
+    if (!resume) {
+        output_file.open(output_path, std::ios::binary | std::ios::trunc);
+        if (!output_file.is_open()) throw std::runtime_error("Cannot open " + output_path);
+        out = &output_file;
+        return;
+    }
+
+    Checkpoint cp = Checkpoint::load(checkpoint_path);
+    if (cp.spec != vector<int>{x_count, y_count, z_count, parent_x, parent_y, parent_z})
+        throw std::runtime_error("Checkpoint " + checkpoint_path + " is for a different model.");
+    if (cp.format != format_name(output_format) || cp.growth != strategy_name(growth_strategy) ||
+        cp.encoding != encoding_name(slab_encoding))
+        throw std::runtime_error("Checkpoint " + checkpoint_path + " was written with --format " + cp.format +
+                                 " --growth " + cp.growth + " --slabs " + cp.encoding + ".");
+    if (static_cast<long long>(cp.slabs_done) * parent_z > z_count + parent_z - 1 || cp.input_offset > mapped->size())
+        throw std::runtime_error("Checkpoint " + checkpoint_path + " does not match the input.");
+
+    // Anything past the checkpoint was written by slabs that are redone
+    std::error_code ec;
+    std::uintmax_t size = std::filesystem::file_size(output_path, ec);
+    if (ec || size < cp.output_offset)
+        throw std::runtime_error("Output " + output_path + " is shorter than its checkpoint.");
+    std::filesystem::resize_file(output_path, cp.output_offset, ec);
+    if (ec) throw std::runtime_error("Cannot truncate " + output_path + ": " + ec.message());
+
+    output_file.open(output_path, std::ios::binary | std::ios::in | std::ios::out);
+    if (!output_file.is_open()) throw std::runtime_error("Cannot open " + output_path);
+    output_file.seekp(0, std::ios::end);
+    out = &output_file;
+    input().seek(cp.input_offset);
+    first_slice = cp.slabs_done * parent_z;
 }
 
-void BlockModel::compress_slices(int top_slice, int n_slices) {
-    for (int y = 0; y < y_count; y += parent_y) {
-        for (int x = 0; x < x_count; x += parent_x) {
-            int z = top_slice;
-            int width  = std::min(parent_x, x_count - x);
-            int height = std::min(parent_y, y_count - y);
-            int depth  = n_slices;
-            char tag = model.at(z % parent_z, y, x);
+// Called once a slab's blocks are written; the checkpoint only ever names
+// bytes that have reached the output file
+void BlockModel::save_checkpoint(const Slab& slab) {
+    int done = slab.top_slice / parent_z + 1;
+    if (done % checkpoint_every != 0 && slab.top_slice + slab.n_slices < z_count) return;
 
-            Block parentBlock(x, y, z, width, height, depth, tag);
-            Flat3D<char> model_slices = slice_model(model, depth, y, parentBlock.y_end, x, parentBlock.x_end);
+    out->flush();
+    if (!*out) throw std::runtime_error("Cannot write " + output_path);
+    Checkpoint cp;
+    cp.spec = {x_count, y_count, z_count, parent_x, parent_y, parent_z};
+    cp.format = format_name(output_format);
+    cp.growth = strategy_name(growth_strategy);
+    cp.encoding = encoding_name(slab_encoding);
+    cp.slabs_done = done;
+    cp.input_offset = slab.input_end;
+    cp.output_offset = static_cast<std::uint64_t>(out->tellp());
+    cp.save(checkpoint_path);
+}
 
-            BlockGrowth growth(model_slices, tag_table);
-            growth.run(parentBlock);
+// Folds the slab's per-parent figures into its SlabStats and files it
+void BlockModel::record_slab_stats(Slab& slab) {
+    SlabStats& st = slab.stats;
+    st.parents = slab.parents.size();
+    for (std::size_t i = 0; i < slab.parents.size(); ++i) {
+        const ParentStats& p = slab.parent_stats[i];
+        st.uniform_parents += slab.parents.uniform(i) ? 1 : 0;
+        st.blocks += p.blocks;
+        st.compress_seconds += p.seconds;
+        if (p.seconds > st.slowest_seconds) {
+            st.slowest_seconds = p.seconds;
+            st.slowest_blocks = p.blocks;
+            st.slowest_x = slab.parents[i].x;
+            st.slowest_y = slab.parents[i].y;
         }
     }
-}
\ No newline at end of file
+    stats.add_slab(st);
+}
+
+void BlockModel::write_slab_blocks(Slab& slab) {
+    if (merger) {
+        merge_blocks.clear();
+        for (std::size_t i = 0; i < slab.n_output; ++i) {
+            std::vector<Block>& blocks = slab.lists[i].blocks;
+            merge_blocks.insert(merge_blocks.end(), blocks.begin(), blocks.end());
+            blocks.clear();
+        }
+        merger->add_slab(merge_blocks, slab.top_slice + slab.n_slices);
+        merged_output->write_to(*out);
+        merged_output->clear();
+        return;
+    }
+
+    for (std::size_t i = 0; i < slab.n_output; ++i) {
+        slab.output[i]->write_to(*out);
+        slab.output[i]->clear();
+    }
+}
@@ -0,0 +1,54 @@
+#include "block_sink.h"
+#include <algorithm>
+#include <cstring>
+
+LabelTable::LabelTable() {
+    for (int i = 0; i < 256; ++i)
+        labels[i] = std::string(1, static_cast<char>(i));
+}
+
+LabelTable::LabelTable(const std::unordered_map<char, std::string>& tag_table) : LabelTable() {
+    for (const auto& entry : tag_table)
+        labels[static_cast<unsigned char>(entry.first)] = entry.second;
+}
+
+// Writes v in decimal at out and returns the end of the digits
+static char* format_int(char* out, int v) {
+    unsigned int u = static_cast<unsigned int>(v);
+    if (v < 0) {
+        *out++ = '-';
+        u = 0u - u;
+    }
+    char digits[10];
+    int n = 0;
+    do {
+        digits[n++] = static_cast<char>('0' + u % 10);
+        u /= 10;
+    } while (u != 0);
+    while (n > 0)
+        *out++ = digits[--n];
+    return out;
+}
+
+TextBlockBuffer::TextBlockBuffer(const LabelTable& labels) : labels(&labels) {}
+
+void TextBlockBuffer::emit(const Block& b) {
+    const std::string& label = (*labels)[b.tag];
+    std::size_t needed = 6 * 12 + label.size() + 1; // six ints with separators
+    if (len + needed > buf.size()) buf.resize(std::max(buf.size() * 2, len + needed));
+
+    char* out = buf.data() + len;
+    const int fields[6] = {b.x, b.y, b.z, b.width, b.height, b.depth};
+    for (int v : fields) {
+        out = format_int(out, v);
+        *out++ = ',';
+    }
+    std::memcpy(out, label.data(), label.size());
+    out += label.size();
+    *out++ = '\n';
+    len = static_cast<std::size_t>(out - buf.data());
+}
+
+void TextBlockBuffer::write_to(std::ostream& out) {
+    out.write(buf.data(), static_cast<std::streamsize>(len));
+}
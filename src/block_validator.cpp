@@ -0,0 +1,348 @@
+#include "block_validator.h"
+#include "binary_format.h"
+#include "row_kernels.h"
+#include <algorithm>
+#include <cstring>
+#include <sstream>
+#include <stdexcept>
+
+using std::string;
+using std::string_view;
+
+namespace {
+
+// Parses an int at s[pos] (optional spaces and sign), leaving pos past it.
+// Returns false if there are no digits.
+bool parse_int(const char* s, std::size_t len, std::size_t& pos, int& value) {
+    while (pos < len && (s[pos] == ' ' || s[pos] == '\t')) ++pos;
+    bool negative = pos < len && s[pos] == '-';
+    if (pos < len && (s[pos] == '-' || s[pos] == '+')) ++pos;
+    std::size_t start = pos;
+    long long v = 0;
+    while (pos < len && s[pos] >= '0' && s[pos] <= '9' && v <= 2147483647LL)
+        v = v * 10 + (s[pos++] - '0');
+    if (pos == start || v > 2147483647LL) return false;
+    while (pos < len && (s[pos] == ' ' || s[pos] == '\t')) ++pos;
+    value = static_cast<int>(negative ? -v : v);
+    return true;
+}
+
+string_view trim(string_view s) {
+    while (!s.empty() && (s.front() == ' ' || s.front() == '\t')) s.remove_prefix(1);
+    while (!s.empty() && (s.back() == ' ' || s.back() == '\t')) s.remove_suffix(1);
+    return s;
+}
+
+string describe(const Block& b) {
+    std::ostringstream out;
+    out << b.x << "," << b.y << "," << b.z << "," << b.width << "," << b.height << "," << b.depth;
+    return out.str();
+}
+
+} // namespace
+
+BlockValidator::BlockValidator(std::istream& model) : model_in(model) {
+    read_header();
+}
+
+void BlockValidator::set_num_threads(unsigned int threads) {
+    num_threads = std::max(1u, threads);
+}
+
+void BlockValidator::set_allow_parent_crossing(bool allow) {
+    allow_parent_crossing = allow;
+}
+
+void BlockValidator::set_max_open_slabs(std::size_t slabs) {
+    max_open_slabs = std::max<std::size_t>(1, slabs);
+}
+
+// The spec line and tag table, read the way BlockModel reads them
+void BlockValidator::read_header() {
+    const char* line;
+    std::size_t len;
+    if (!model_in.next_line(line, len)) throw std::runtime_error("Model input is empty.");
+    int spec[6];
+    std::size_t pos = 0;
+    for (int i = 0; i < 6; ++i) {
+        if (!parse_int(line, len, pos, spec[i]) || (i < 5 && (pos >= len || line[pos++] != ',')) ||
+            (i == 5 && pos != len))
+            throw std::runtime_error("Invalid specification line (need 6 ints).");
+        if (spec[i] <= 0) throw std::runtime_error("Invalid specification line (dimensions must be positive).");
+    }
+    x_count = spec[0];
+    y_count = spec[1];
+    z_count = spec[2];
+    parent_x = spec[3];
+    parent_y = spec[4];
+    parent_z = spec[5];
+    total_slabs = (z_count + parent_z - 1) / parent_z;
+
+    std::unordered_map<char, string> tag_table;
+    while (model_in.next_line(line, len) && len > 0) {
+        string_view entry(line, len);
+        std::size_t sep = entry.find(", ");
+        if (sep == string_view::npos || sep == 0) throw std::runtime_error("Invalid tag table line: " + string(entry));
+        tag_table[line[0]] = string(entry.substr(sep + 2));
+    }
+
+    // Every byte gets a label id; label_names never reallocates (at most 256
+    // labels), so label_ids can key on views of its strings
+    LabelTable labels(tag_table);
+    label_names.reserve(256);
+    std::unordered_map<string, int> ids;
+    for (int i = 0; i < 256; ++i) {
+        const string& name = labels[static_cast<char>(i)];
+        auto it = ids.find(name);
+        if (it == ids.end()) {
+            it = ids.emplace(name, static_cast<int>(label_names.size())).first;
+            label_names.push_back(name);
+            label_tag.push_back(i);
+        } else {
+            label_tag[it->second] = -1;
+        }
+        tag_label[i] = it->second;
+    }
+    for (std::size_t i = 0; i < label_names.size(); ++i) label_ids.emplace(label_names[i], static_cast<int>(i));
+}
+
+int BlockValidator::label_id(string_view label) const {
+    auto it = label_ids.find(label);
+    return it == label_ids.end() ? -1 : it->second;
+}
+
+void BlockValidator::error(const string& message) {
+    std::lock_guard<std::mutex> lock(report_mtx);
+    if (report.errors.size() < MAX_ERRORS) report.errors.push_back(message);
+}
+
+ValidationReport BlockValidator::validate(std::istream& blocks) {
+    if (num_threads > 1) pool = std::make_unique<ThreadPool>(num_threads);
+
+    if (blocks.peek() == 'B')
+        read_binary_blocks(blocks);
+    else
+        read_text_blocks(blocks);
+
+    // Whatever is still open has gaps; slabs no block reached are all gap
+    while (!open.empty())
+        close_slab(first_open); // the front slab is never a closed one
+    for (int i = slabs_read; i < total_slabs; ++i) {
+        int top = i * parent_z;
+        std::uint64_t volume = static_cast<std::uint64_t>(std::min(parent_z, z_count - top)) * y_count * x_count;
+        report.gap_voxels += volume;
+        error("Gap: no block covers slices " + std::to_string(top) + ".." +
+              std::to_string(top + std::min(parent_z, z_count - top) - 1));
+    }
+    if (pool) pool->wait(checks);
+    return report;
+}
+
+void BlockValidator::read_text_blocks(std::istream& in) {
+    LineReader reader(in);
+    const char* line;
+    std::size_t len;
+    std::uint64_t n = 0;
+    while (reader.next_line(line, len)) {
+        if (len == 0) continue;
+        int v[6];
+        std::size_t pos = 0;
+        bool ok = true;
+        for (int i = 0; i < 6 && ok; ++i)
+            ok = parse_int(line, len, pos, v[i]) && pos < len && line[pos++] == ',';
+        ++n;
+        if (!ok) {
+            report.bad_blocks++;
+            error("Malformed block line " + std::to_string(n) + ": " + string(line, len));
+            continue;
+        }
+
+        string_view label = trim(string_view(line + pos, len - pos));
+        int id = label_id(label);
+        if (id < 0) {
+            report.bad_blocks++;
+            error("Unknown label \"" + string(label) + "\" on block line " + std::to_string(n));
+            continue;
+        }
+        add_block(Block(v[0], v[1], v[2], v[3], v[4], v[5], '\0'), id, n);
+    }
+    report.blocks = n;
+}
+
+void BlockValidator::read_binary_blocks(std::istream& in) {
+    BinaryBlockReader reader(in);
+    const BinaryHeader& h = reader.header();
+    if (h.x_count != x_count || h.y_count != y_count || h.z_count != z_count || h.parent_x != parent_x ||
+        h.parent_y != parent_y || h.parent_z != parent_z)
+        throw std::runtime_error("Binary output header does not match the model specification.");
+
+    // Tag bytes in the output resolve through the output's own tag table
+    LabelTable labels(h.tag_table());
+    int block_label[256];
+    for (int i = 0; i < 256; ++i) block_label[i] = label_id(labels[static_cast<char>(i)]);
+
+    Block b(0, 0, 0, 0, 0, 0, '\0');
+    std::uint64_t n = 0;
+    while (reader.next(b)) {
+        ++n;
+        int id = block_label[static_cast<unsigned char>(b.tag)];
+        if (id < 0) {
+            report.bad_blocks++;
+            error("Unknown label \"" + labels[b.tag] + "\" on block " + std::to_string(n));
+            continue;
+        }
+        add_block(b, id, n);
+    }
+    report.blocks = n;
+}
+
+void BlockValidator::add_block(const Block& b, int label, std::uint64_t index) {
+    if (b.width <= 0 || b.height <= 0 || b.depth <= 0 || b.x < 0 || b.y < 0 || b.z < 0 ||
+        b.x > x_count - b.width || b.y > y_count - b.height || b.z > z_count - b.depth) {
+        report.bad_blocks++;
+        error("Block " + std::to_string(index) + " (" + describe(b) + ") is empty or outside the model");
+        return;
+    }
+    if (!allow_parent_crossing && (b.x / parent_x != (b.x_end - 1) / parent_x ||
+                                   b.y / parent_y != (b.y_end - 1) / parent_y ||
+                                   b.z / parent_z != (b.z_end - 1) / parent_z)) {
+        report.parent_crossings++;
+        error("Block " + std::to_string(index) + " (" + describe(b) + ") crosses a parent block boundary");
+    }
+
+    bool overlap_reported = false;
+    for (int s = b.z / parent_z; s <= (b.z_end - 1) / parent_z; ++s) {
+        int z0 = std::max(b.z, s * parent_z), z1 = std::min(b.z_end, (s + 1) * parent_z);
+        bool closed = s < first_open || (s < slabs_read && !open[s - first_open]);
+        if (closed) {
+            // Every voxel of a closed slab was already covered
+            report.overlap_voxels += static_cast<std::uint64_t>(z1 - z0) * b.height * b.width;
+            if (!overlap_reported) error("Block " + std::to_string(index) + " (" + describe(b) + ") overlaps");
+            overlap_reported = true;
+            continue;
+        }
+
+        Slab& sl = slab(s);
+        std::uint64_t overlaps = 0;
+        for (int z = z0 - sl.top_slice; z < z1 - sl.top_slice; ++z)
+            for (int y = b.y; y < b.y_end; ++y) {
+                int already = sl.covered.row_count(z, y, b.x, b.x_end);
+                overlaps += already;
+                sl.covered_count += b.width - already;
+                sl.covered.row_set(z, y, b.x, b.x_end);
+            }
+        if (overlaps) {
+            report.overlap_voxels += overlaps;
+            if (!overlap_reported) error("Block " + std::to_string(index) + " (" + describe(b) + ") overlaps");
+            overlap_reported = true;
+        }
+        sl.pieces.push_back({b.x, b.y, z0 - sl.top_slice, b.width, b.height, z1 - z0, label, index});
+        if (sl.covered_count == sl.volume()) close_slab(s);
+    }
+}
+
+// The open slab with the given index, reading model rows up to it. Opening
+// one past the limit closes the oldest open slab.
+BlockValidator::Slab& BlockValidator::slab(int index) {
+    while (slabs_read <= index) {
+        auto s = std::make_unique<Slab>();
+        s->index = slabs_read;
+        s->top_slice = slabs_read * parent_z;
+        s->n_slices = std::min(parent_z, z_count - s->top_slice);
+        s->rows = Flat3D<char>(s->n_slices, y_count, x_count);
+        s->covered.reset(s->n_slices, y_count, x_count);
+
+        const char* line;
+        std::size_t len;
+        for (int z = 0; z < s->n_slices; ++z) {
+            for (int y = 0; y < y_count; ++y) {
+                if (!model_in.next_line(line, len) || len < static_cast<std::size_t>(x_count))
+                    throw std::runtime_error("Model row shorter than x_count.");
+                std::memcpy(&s->rows.at(z, y, 0), line, x_count);
+            }
+            if (s->top_slice + z < z_count - 1) model_in.next_line(line, len); // blank separator
+        }
+        open.push_back(std::move(s));
+        ++slabs_read;
+
+        std::size_t n_open = 0;
+        for (const auto& o : open) n_open += o ? 1 : 0;
+        if (n_open > max_open_slabs) {
+            for (int i = first_open; i < index; ++i)
+                if (open[i - first_open]) {
+                    close_slab(i);
+                    break;
+                }
+        }
+    }
+    return *open[index - first_open];
+}
+
+// Hands a slab to the checks (on the pool when there is one). At most two
+// checks per thread are queued at a time, which bounds the closed slabs held.
+void BlockValidator::close_slab(int index) {
+    std::shared_ptr<Slab> s(std::move(open[index - first_open]));
+    while (!open.empty() && !open.front()) {
+        open.pop_front();
+        ++first_open;
+    }
+
+    if (!pool) {
+        check_slab(*s);
+        return;
+    }
+    pool->submit(checks, [this, s] { check_slab(*s); });
+    if (++checks_in_flight >= 2 * static_cast<std::size_t>(num_threads)) {
+        pool->wait(checks);
+        checks_in_flight = 0;
+    }
+}
+
+// Counts the slab's gaps and the covered voxels whose tag has another label
+void BlockValidator::check_slab(Slab& s) {
+    std::uint64_t gaps = 0, mismatches = 0;
+    string first_gap, first_mismatch;
+
+    if (s.covered_count != s.volume()) {
+        for (int z = 0; z < s.n_slices; ++z)
+            for (int y = 0; y < y_count; ++y) {
+                int missing = x_count - s.covered.row_count(z, y, 0, x_count);
+                if (missing == 0) continue;
+                if (first_gap.empty()) {
+                    int x = 0;
+                    while (s.covered.test(z, y, x)) ++x;
+                    first_gap = "Gap: voxel (" + std::to_string(x) + "," + std::to_string(y) + "," +
+                                std::to_string(s.top_slice + z) + ") is not covered";
+                }
+                gaps += missing;
+            }
+    }
+
+    for (const Piece& p : s.pieces) {
+        int tag = label_tag[p.label];
+        std::uint64_t bad = 0;
+        for (int z = p.z; z < p.z + p.depth; ++z)
+            for (int y = p.y; y < p.y + p.height; ++y) {
+                const char* row = &s.rows.at(z, y, p.x);
+                if (tag >= 0) {
+                    bad += p.width - row_count_matches(row, p.width, static_cast<char>(tag));
+                } else {
+                    for (int x = 0; x < p.width; ++x)
+                        bad += tag_label[static_cast<unsigned char>(row[x])] != p.label ? 1 : 0;
+                }
+            }
+        if (bad && first_mismatch.empty())
+            first_mismatch = "Block " + std::to_string(p.block) + " is labelled \"" + label_names[p.label] +
+                             "\" but " + std::to_string(bad) + " of its voxels in slices " +
+                             std::to_string(s.top_slice + p.z) + ".." +
+                             std::to_string(s.top_slice + p.z + p.depth - 1) + " have another label";
+        mismatches += bad;
+    }
+
+    std::lock_guard<std::mutex> lock(report_mtx);
+    report.covered_voxels += s.covered_count;
+    report.gap_voxels += gaps;
+    report.mismatch_voxels += mismatches;
+    for (const string* m : {&first_gap, &first_mismatch})
+        if (!m->empty() && report.errors.size() < MAX_ERRORS) report.errors.push_back(*m);
+}
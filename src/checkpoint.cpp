@@ -0,0 +1,73 @@
+#include "checkpoint.h"
+#include <filesystem>
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+#include <system_error>
+
+using std::string;
+
+// First line of every checkpoint file; bumped if the fields change
+static const char* const CHECKPOINT_MAGIC = "block-model-checkpoint 2";
+
+void Checkpoint::save(const string& path) const {
+    string tmp = path + ".tmp";
+    {
+        std::ofstream out(tmp, std::ios::binary | std::ios::trunc);
+        if (!out.is_open()) throw std::runtime_error("Cannot write checkpoint " + tmp);
+        out << CHECKPOINT_MAGIC << "\nspec";
+        for (std::size_t i = 0; i < spec.size(); ++i)
+            out << (i ? "," : " ") << spec[i];
+        out << "\nformat " << format << "\ngrowth " << growth << "\nencoding " << encoding;
+        out << "\nslabs " << slabs_done << "\ninput " << input_offset << "\noutput " << output_offset << "\n";
+        out.flush();
+        if (!out) throw std::runtime_error("Cannot write checkpoint " + tmp);
+    }
+
+    std::error_code ec;
+    std::filesystem::rename(tmp, path, ec);
+    if (ec) throw std::runtime_error("Cannot replace checkpoint " + path + ": " + ec.message());
+}
+
+Checkpoint Checkpoint::load(const string& path) {
+    std::ifstream in(path, std::ios::binary);
+    if (!in.is_open()) throw std::runtime_error("Cannot open checkpoint " + path);
+
+    Checkpoint cp;
+    string line, key;
+    bool has_slabs = false, has_input = false, has_output = false;
+    if (!std::getline(in, line) || line != CHECKPOINT_MAGIC)
+        throw std::runtime_error("Not a checkpoint file: " + path);
+    while (std::getline(in, line)) {
+        std::istringstream fields(line);
+        fields >> key;
+        if (key == "spec") {
+            string values;
+            fields >> values;
+            std::istringstream csv(values);
+            for (string v; std::getline(csv, v, ',');) {
+                try {
+                    cp.spec.push_back(std::stoi(v));
+                } catch (const std::logic_error&) {
+                    throw std::runtime_error("Malformed checkpoint " + path);
+                }
+            }
+        } else if (key == "format") {
+            fields >> cp.format;
+        } else if (key == "growth") {
+            fields >> cp.growth;
+        } else if (key == "encoding") {
+            fields >> cp.encoding;
+        } else if (key == "slabs") {
+            has_slabs = static_cast<bool>(fields >> cp.slabs_done);
+        } else if (key == "input") {
+            has_input = static_cast<bool>(fields >> cp.input_offset);
+        } else if (key == "output") {
+            has_output = static_cast<bool>(fields >> cp.output_offset);
+        }
+    }
+
+    if (cp.spec.size() != 6 || cp.format.empty() || cp.growth.empty() || cp.encoding.empty() || !has_slabs || !has_input || !has_output || cp.slabs_done < 0)
+        throw std::runtime_error("Malformed checkpoint " + path);
+    return cp;
+}
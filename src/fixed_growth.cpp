@@ -0,0 +1,24 @@
+#include "fixed_growth.h"
+
+// Parent sizes seen in practice; anything else uses the generic BlockGrowth
+bool run_fixed_growth(const Flat3DView<const char>& model, const Block& parent, BlockSink& out) {
+    int w = parent.width, h = parent.height, d = parent.depth;
+    if (w == 4 && h == 4 && d == 4) {
+        FixedGrowth<4, 4, 4>::run(model, parent, out);
+    } else if (w == 8 && h == 8 && d == 8) {
+        FixedGrowth<8, 8, 8>::run(model, parent, out);
+    } else if (w == 2 && h == 2 && d == 2) {
+        FixedGrowth<2, 2, 2>::run(model, parent, out);
+    } else if (w == 4 && h == 4 && d == 2) {
+        FixedGrowth<4, 4, 2>::run(model, parent, out);
+    } else if (w == 4 && h == 4 && d == 8) {
+        FixedGrowth<4, 4, 8>::run(model, parent, out);
+    } else if (w == 8 && h == 8 && d == 2) {
+        FixedGrowth<8, 8, 2>::run(model, parent, out);
+    } else if (w == 8 && h == 8 && d == 4) {
+        FixedGrowth<8, 8, 4>::run(model, parent, out);
+    } else {
+        return false;
+    }
+    return true;
+}
@@ -0,0 +1,58 @@
+#include "line_reader.h"
+#include <cstring>
+#include <stdexcept>
+
+LineReader::LineReader(std::istream& in, std::size_t buffer_size)
+    : src(in.rdbuf()), buf(buffer_size > 0 ? buffer_size : 1) {
+    base = buf.data();
+}
+
+LineReader::LineReader(const char* data, std::size_t size) : base(data), end(size), eof(true) {}
+
+bool LineReader::next_line(const char*& line, std::size_t& len) {
+    while (true) {
+        const char* start = base + pos;
+        const void* nl = std::memchr(start + scan, '\n', end - pos - scan);
+        if (nl || (eof && pos < end)) {
+            // Either a full line, or the last line of input without a '\n'
+            len = nl ? static_cast<const char*>(nl) - start : end - pos;
+            line = start;
+            pos += nl ? len + 1 : len;
+            scan = 0;
+            if (len > 0 && line[len - 1] == '\r') --len;
+            return true;
+        }
+        if (eof) {
+            line = start;
+            len = 0;
+            return false;
+        }
+        scan = end - pos;
+        refill();
+    }
+}
+
+void LineReader::seek(std::size_t offset) {
+    if (src) throw std::logic_error("LineReader::seek needs an in-memory reader");
+    pos = offset < end ? offset : end;
+    scan = 0;
+}
+
+void LineReader::refill() {
+    // Keep the partial line, moved to the front; grow only if it fills the buffer
+    std::size_t pending = end - pos;
+    if (pos > 0) {
+        std::memmove(buf.data(), buf.data() + pos, pending);
+        origin += pos;
+        pos = 0;
+        end = pending;
+    }
+    if (end == buf.size()) buf.resize(buf.size() * 2);
+    base = buf.data();
+
+    std::streamsize n = src->sgetn(buf.data() + end, static_cast<std::streamsize>(buf.size() - end));
+    if (n <= 0)
+        eof = true;
+    else
+        end += static_cast<std::size_t>(n);
+}
@@ -1,14 +1,170 @@
+#include "binary_format.h"
 #include "block_model.h"
+#include <climits>
+#include <fstream>
 #include <iostream>
+#include <string>
 
-int main() {
+#ifdef _WIN32
+#include <fcntl.h>
+#include <io.h>
+#endif
+
+static void print_usage(const char* prog) {
+  std::cerr << "Usage: " << prog
+            << " [--threads N] [--growth greedy|largest|scanline|octree] [--input FILE]"
+               " [--format text|binary] [--slabs dense|rle|packed] [--merge none|z|xyz] [--stats]\n"
+               "       [--output FILE] [--checkpoint FILE [--checkpoint-every N] [--resume]]\n"
+            << "       " << prog << " --decode FILE\n";
+}
+
+// Parses a positive decimal count; false on a sign, stray characters or
+// overflow
+static bool parse_count(const char* s, int& out) {
+  if (*s < '0' || *s > '9') return false;
+  long long v = 0;
+  for (; *s >= '0' && *s <= '9'; ++s) {
+    v = v * 10 + (*s - '0');
+    if (v > INT_MAX) return false;
+  }
+  if (*s != '\0' || v < 1) return false;
+  out = static_cast<int>(v);
+  return true;
+}
+
+// Prints a binary output file in the text format
+static int decode(const char* path) {
+  std::ifstream in(path, std::ios::binary);
+  if (!in.is_open()) {
+    std::cerr << "Cannot open " << path << "\n";
+    return 1;
+  }
+  try {
+    binary_to_text(in, std::cout);
+  } catch (const std::exception& e) {
+    std::cerr << e.what() << "\n";
+    return 1;
+  }
+  return 0;
+}
+
+int main(int argc, char* argv[]) {
   std::ios::sync_with_stdio(false);
   std::cin.tie(nullptr);
 
   BlockModel bm;
-  bm.read_specification();
-  bm.read_tag_table();
-  bm.read_model();
+  std::string checkpoint_path;
+  int checkpoint_every = 16;
+  for (int i = 1; i < argc; ++i) {
+    std::string arg = argv[i];
+    if (arg == "--threads" && i + 1 < argc) {
+      int threads = 0;
+      if (!parse_count(argv[++i], threads)) {
+        print_usage(argv[0]);
+        return 1;
+      }
+      bm.set_num_threads(static_cast<unsigned int>(threads));
+    } else if (arg == "--growth" && i + 1 < argc) {
+      std::string name = argv[++i];
+      if (name == "greedy") {
+        bm.set_growth_strategy(GrowthStrategy::Greedy);
+      } else if (name == "largest") {
+        bm.set_growth_strategy(GrowthStrategy::LargestBox);
+      } else if (name == "scanline") {
+        bm.set_growth_strategy(GrowthStrategy::Scanline);
+      } else if (name == "octree") {
+        bm.set_growth_strategy(GrowthStrategy::Octree);
+      } else {
+        print_usage(argv[0]);
+        return 1;
+      }
+    } else if (arg == "--input" && i + 1 < argc) {
+      try {
+        bm.set_input_file(argv[++i]);
+      } catch (const std::exception& e) {
+        std::cerr << e.what() << "\n";
+        return 1;
+      }
+    } else if (arg == "--format" && i + 1 < argc) {
+      std::string name = argv[++i];
+      if (name == "text") {
+        bm.set_output_format(OutputFormat::Text);
+      } else if (name == "binary") {
+        bm.set_output_format(OutputFormat::Binary);
+#ifdef _WIN32
+        _setmode(_fileno(stdout), _O_BINARY);
+#endif
+      } else {
+        print_usage(argv[0]);
+        return 1;
+      }
+    } else if (arg == "--slabs" && i + 1 < argc) {
+      std::string name = argv[++i];
+      if (name == "dense") {
+        bm.set_slab_encoding(SlabEncoding::Dense);
+      } else if (name == "rle") {
+        bm.set_slab_encoding(SlabEncoding::Rle);
+      } else if (name == "packed") {
+        bm.set_slab_encoding(SlabEncoding::Packed);
+      } else {
+        print_usage(argv[0]);
+        return 1;
+      }
+    } else if (arg == "--merge" && i + 1 < argc) {
+      std::string name = argv[++i];
+      if (name == "none") {
+        bm.set_merge_mode(MergeMode::None);
+      } else if (name == "z") {
+        bm.set_merge_mode(MergeMode::Z);
+      } else if (name == "xyz") {
+        bm.set_merge_mode(MergeMode::XYZ);
+      } else {
+        print_usage(argv[0]);
+        return 1;
+      }
+    } else if (arg == "--stats") {
+      try {
+        bm.set_collect_stats(true);
+      } catch (const std::exception& e) {
+        std::cerr << e.what() << "\n";
+        return 1;
+      }
+    } else if (arg == "--output" && i + 1 < argc) {
+      bm.set_output_file(argv[++i]);
+    } else if (arg == "--checkpoint" && i + 1 < argc) {
+      checkpoint_path = argv[++i];
+    } else if (arg == "--checkpoint-every" && i + 1 < argc) {
+      if (!parse_count(argv[++i], checkpoint_every)) {
+        print_usage(argv[0]);
+        return 1;
+      }
+    } else if (arg == "--resume") {
+      bm.set_resume(true);
+    } else if (arg == "--decode" && i + 1 < argc) {
+      return decode(argv[++i]);
+    } else {
+      print_usage(argv[0]);
+      return 1;
+    }
+  }
+
+  if (!checkpoint_path.empty()) {
+    try {
+      bm.set_checkpoint(checkpoint_path, checkpoint_every);
+    } catch (const std::exception& e) {
+      std::cerr << e.what() << "\n";
+      return 1;
+    }
+  }
+
+  try {
+    bm.read_specification();
+    bm.read_tag_table();
+    bm.read_model();
+  } catch (const std::exception& e) {
+    std::cerr << e.what() << "\n";
+    return 1;
+  }
   return 0;
 } // Test comment
 // Test comment for pre-commit hook
@@ -0,0 +1,73 @@
+#include "packed_slab.h"
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+
+using std::string;
+
+TagIds::TagIds() {
+    std::fill(std::begin(ids), std::end(ids), -1);
+    std::fill(std::begin(tags), std::end(tags), '\0');
+}
+
+TagIds::TagIds(const std::unordered_map<char, string>& tag_table) : TagIds() {
+    for (const auto& entry : tag_table)
+        ids[static_cast<unsigned char>(entry.first)] = 0;
+    for (int i = 0; i < 256; ++i) {
+        if (ids[i] < 0) continue;
+        ids[i] = n;
+        tags[n++] = static_cast<char>(i);
+    }
+}
+
+void PackedSlab::set_tags(const TagIds& ids) {
+    if (ids.count() > MAX_TAGS) throw std::runtime_error("Too many tags for a packed slab.");
+    for (int i = 0; i < 256; ++i)
+        tag_id[i] = static_cast<signed char>(ids.id(static_cast<char>(i)));
+
+    // Unused ids decode to the first tag; append_row never stores them
+    for (int i = 0; i < 256; ++i) {
+        int lo = i & 15, hi = i >> 4;
+        pair_tags[i][0] = ids.tag(lo < ids.count() ? lo : 0);
+        pair_tags[i][1] = ids.tag(hi < ids.count() ? hi : 0);
+    }
+}
+
+void PackedSlab::reset(int d, int h, int w) {
+    depth = d;
+    height = h;
+    width = w;
+    row_bytes = (static_cast<std::size_t>(w) + 1) / 2;
+    cells.resize(static_cast<std::size_t>(d) * h * row_bytes);
+    rows = 0;
+}
+
+bool PackedSlab::append_row(const char* row) {
+    unsigned char* out = cells.data() + rows * row_bytes;
+    // Ids are 0..15, so a tag outside the table shows up as a negative OR
+    int bad = 0;
+    int x = 0;
+    for (; x + 1 < width; x += 2) {
+        int lo = tag_id[static_cast<unsigned char>(row[x])];
+        int hi = tag_id[static_cast<unsigned char>(row[x + 1])];
+        bad |= lo | hi;
+        *out++ = static_cast<unsigned char>(lo | (hi << 4));
+    }
+    if (x < width) {
+        int lo = tag_id[static_cast<unsigned char>(row[x])];
+        bad |= lo;
+        *out = static_cast<unsigned char>(lo & 15);
+    }
+
+    if (bad < 0) return false;
+    ++rows;
+    return true;
+}
+
+void PackedSlab::decode(int z, int y, int x0, int x1, char* out) const {
+    const unsigned char* row = cells.data() + row_offset(z, y);
+    if (x0 < x1 && (x0 & 1)) *out++ = pair_tags[row[x0++ / 2]][1];
+    for (; x0 + 1 < x1; x0 += 2, out += 2)
+        std::memcpy(out, pair_tags[row[x0 / 2]], 2);
+    if (x0 < x1) *out = pair_tags[row[x0 / 2]][0];
+}
@@ -0,0 +1,48 @@
+#include "rle_slab.h"
+#include "row_kernels.h"
+#include <algorithm>
+#include <cstring>
+
+void RleSlab::reset(int d, int h, int w) {
+    depth = d;
+    height = h;
+    width = w;
+    starts.clear();
+    tags.clear();
+    row_begin.assign(1, 0);
+}
+
+void RleSlab::append_row(const char* row) {
+    // Each run's end is found with the vectorised mismatch scan
+    for (int x = 0; x < width;) {
+        starts.push_back(x);
+        tags.push_back(row[x]);
+        x += row_find_mismatch(row + x, width - x, row[x]);
+    }
+    row_begin.push_back(static_cast<int>(tags.size()));
+}
+
+int RleSlab::run_at(int z, int y, int x) const {
+    int r = row(z, y);
+    const int* first = starts.data() + row_begin[r];
+    const int* last = starts.data() + row_begin[r + 1];
+    return static_cast<int>(std::upper_bound(first, last, x) - starts.data()) - 1;
+}
+
+bool RleSlab::window_is(char tag, int z0, int z1, int y0, int y1, int x0, int x1) const {
+    for (int z = z0; z < z1; ++z)
+        for (int y = y0; y < y1; ++y) {
+            int run = run_at(z, y, x0);
+            if (tags[run] != tag || run_end(z, y, run) < x1) return false;
+        }
+    return true;
+}
+
+void RleSlab::decode(int z, int y, int x0, int x1, char* out) const {
+    for (int run = run_at(z, y, x0); x0 < x1; ++run) {
+        int end = std::min(run_end(z, y, run), x1);
+        std::memset(out, tags[run], end - x0);
+        out += end - x0;
+        x0 = end;
+    }
+}
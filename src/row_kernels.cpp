@@ -0,0 +1,137 @@
+#include "row_kernels.h"
+
+#if defined(__GNUC__) && defined(__x86_64__)
+#define ROW_KERNELS_X86 1
+#include <immintrin.h>
+#endif
+
+namespace {
+
+int find_mismatch_scalar(const char* row, int n, char tag) {
+    for (int i = 0; i < n; ++i)
+        if (row[i] != tag) return i;
+    return n;
+}
+
+int find_match_scalar(const char* row, int n, char tag) {
+    for (int i = 0; i < n; ++i)
+        if (row[i] == tag) return i;
+    return n;
+}
+
+int count_matches_scalar(const char* row, int n, char tag) {
+    int count = 0;
+    for (int i = 0; i < n; ++i)
+        count += row[i] == tag ? 1 : 0;
+    return count;
+}
+
+#if ROW_KERNELS_X86
+// SSE2 is part of the x86-64 baseline, so these need no target attribute and
+// are inlined (VEX-encoded) into the AVX2 kernels for their 16..31 byte tails;
+// calling legacy-SSE code with dirty upper YMM state is very slow on some CPUs.
+inline int find_mismatch_sse2(const char* row, int n, char tag) {
+    const __m128i t = _mm_set1_epi8(tag);
+    int i = 0;
+    for (; i + 16 <= n; i += 16) {
+        __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(row + i));
+        unsigned eq = static_cast<unsigned>(_mm_movemask_epi8(_mm_cmpeq_epi8(v, t)));
+        if (eq != 0xFFFFu) return i + __builtin_ctz(~eq);
+    }
+    return i + find_mismatch_scalar(row + i, n - i, tag);
+}
+
+inline int find_match_sse2(const char* row, int n, char tag) {
+    const __m128i t = _mm_set1_epi8(tag);
+    int i = 0;
+    for (; i + 16 <= n; i += 16) {
+        __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(row + i));
+        unsigned eq = static_cast<unsigned>(_mm_movemask_epi8(_mm_cmpeq_epi8(v, t)));
+        if (eq != 0) return i + __builtin_ctz(eq);
+    }
+    return i + find_match_scalar(row + i, n - i, tag);
+}
+
+inline int count_matches_sse2(const char* row, int n, char tag) {
+    const __m128i t = _mm_set1_epi8(tag);
+    int count = 0;
+    int i = 0;
+    for (; i + 16 <= n; i += 16) {
+        __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(row + i));
+        count += __builtin_popcount(static_cast<unsigned>(_mm_movemask_epi8(_mm_cmpeq_epi8(v, t))));
+    }
+    return count + count_matches_scalar(row + i, n - i, tag);
+}
+
+__attribute__((target("avx2"))) int find_mismatch_avx2(const char* row, int n, char tag) {
+    const __m256i t = _mm256_set1_epi8(tag);
+    int i = 0;
+    for (; i + 32 <= n; i += 32) {
+        __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(row + i));
+        unsigned eq = static_cast<unsigned>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(v, t)));
+        if (eq != 0xFFFFFFFFu) return i + __builtin_ctz(~eq);
+    }
+    return i + find_mismatch_sse2(row + i, n - i, tag);
+}
+
+__attribute__((target("avx2"))) int find_match_avx2(const char* row, int n, char tag) {
+    const __m256i t = _mm256_set1_epi8(tag);
+    int i = 0;
+    for (; i + 32 <= n; i += 32) {
+        __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(row + i));
+        unsigned eq = static_cast<unsigned>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(v, t)));
+        if (eq != 0) return i + __builtin_ctz(eq);
+    }
+    return i + find_match_sse2(row + i, n - i, tag);
+}
+
+__attribute__((target("avx2"))) int count_matches_avx2(const char* row, int n, char tag) {
+    const __m256i t = _mm256_set1_epi8(tag);
+    int count = 0;
+    int i = 0;
+    for (; i + 32 <= n; i += 32) {
+        __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(row + i));
+        count += __builtin_popcount(static_cast<unsigned>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(v, t))));
+    }
+    return count + count_matches_sse2(row + i, n - i, tag);
+}
+#endif
+
+struct RowKernels {
+    int (*find_mismatch)(const char*, int, char);
+    int (*find_match)(const char*, int, char);
+    int (*count_matches)(const char*, int, char);
+    const char* isa;
+};
+
+RowKernels select_kernels() {
+#if ROW_KERNELS_X86
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2"))
+        return {find_mismatch_avx2, find_match_avx2, count_matches_avx2, "avx2"};
+    return {find_mismatch_sse2, find_match_sse2, count_matches_sse2, "sse2"};
+#else
+    return {find_mismatch_scalar, find_match_scalar, count_matches_scalar, "scalar"};
+#endif
+}
+
+// Selected during static initialisation; no kernel runs before main()
+const RowKernels selected = select_kernels();
+
+} // namespace
+
+int row_find_mismatch_wide(const char* row, int n, char tag) {
+    return selected.find_mismatch(row, n, tag);
+}
+
+int row_find_match_wide(const char* row, int n, char tag) {
+    return selected.find_match(row, n, tag);
+}
+
+int row_count_matches_wide(const char* row, int n, char tag) {
+    return selected.count_matches(row, n, tag);
+}
+
+const char* row_kernels_isa() {
+    return selected.isa;
+}
@@ -0,0 +1,45 @@
+#include "slab_parents.h"
+#include "row_kernels.h"
+#include <algorithm>
+
+void SlabParents::reset(const ModelSpec& spec_, int top_slice, int n_slices) {
+    spec = spec_;
+    top = top_slice;
+    depth = n_slices;
+    per_row = (spec.x_count + spec.parent_x - 1) / spec.parent_x;
+
+    parents.clear();
+    for (int y = 0; y < spec.y_count; y += spec.parent_y)
+        for (int x = 0; x < spec.x_count; x += spec.parent_x)
+            parents.emplace_back(x, y, top_slice, std::min(spec.parent_x, spec.x_count - x),
+                                 std::min(spec.parent_y, spec.y_count - y), n_slices, '\0');
+    uniform_.assign(parents.size(), 1);
+
+    long long cells = static_cast<long long>(spec.parent_x) * spec.parent_y * std::max(n_slices, 1);
+    std::size_t by_cells = static_cast<std::size_t>((MIN_RUN_CELLS + cells - 1) / cells);
+    run_length = std::max<std::size_t>(1, std::min(by_cells, parents.size() / MIN_RUNS));
+}
+
+void SlabParents::summarize_row(int z, int y, const char* row) {
+    std::size_t i = static_cast<std::size_t>(y / spec.parent_y) * per_row;
+    bool first = z == 0 && y % spec.parent_y == 0;
+    for (int x = 0; x < spec.x_count; x += spec.parent_x, ++i) {
+        if (first) parents[i].tag = row[x];
+        if (!uniform_[i]) continue;
+        int width = parents[i].width;
+        if (row[x] != parents[i].tag || row_find_mismatch(row + x, width, row[x]) != width) uniform_[i] = 0;
+    }
+}
+
+void SlabParents::set_summary(std::size_t i, char tag, bool uniform) {
+    parents[i].tag = tag;
+    uniform_[i] = uniform ? 1 : 0;
+}
+
+void compress_parent_block(const Flat3DView<const char>& model, const Block& parent, bool uniform,
+                           GrowthStrategy strategy, BlockSink& out) {
+    if (uniform)
+        out.emit(parent);
+    else
+        grow_parent_block(model, parent, strategy, out);
+}
@@ -0,0 +1,130 @@
+#include "stats.h"
+#include <cmath>
+#include <memory>
+#include <mutex>
+
+namespace {
+
+// Every thread's counters, kept for the life of the process so totals can be
+// read after the threads that counted have gone
+std::mutex registry_mtx;
+std::vector<std::unique_ptr<StatCounters>> registry;
+
+// JSON has no inf or nan (e.g. a rate over a zero duration)
+void write_number(std::ostream& out, double v) {
+    if (std::isfinite(v))
+        out << v;
+    else
+        out << "null";
+}
+
+} // namespace
+
+StatCounters& StatCounters::operator+=(const StatCounters& o) {
+    parents_fixed += o.parents_fixed;
+    parents_grown += o.parents_grown;
+    parent_decodes += o.parent_decodes;
+    fit_calls += o.fit_calls;
+    fit_shrinks += o.fit_shrinks;
+    window_checks += o.window_checks;
+    grow_steps += o.grow_steps;
+    return *this;
+}
+
+StatCounters& Stats::local() {
+    thread_local StatCounters* counters = [] {
+        std::lock_guard<std::mutex> lock(registry_mtx);
+        registry.push_back(std::make_unique<StatCounters>());
+        return registry.back().get();
+    }();
+    return *counters;
+}
+
+StatCounters Stats::total() {
+    std::lock_guard<std::mutex> lock(registry_mtx);
+    StatCounters sum;
+    for (const auto& c : registry) sum += *c;
+    return sum;
+}
+
+void Stats::reset() {
+    std::lock_guard<std::mutex> lock(registry_mtx);
+    for (auto& c : registry) *c = StatCounters();
+}
+
+void StatsReport::write_json(std::ostream& out, const StatCounters& counters) const {
+    std::uint64_t parents = 0, uniform = 0, blocks = 0;
+    double read = 0.0, compress = 0.0, write = 0.0;
+    const SlabStats* slowest = nullptr;
+    for (const SlabStats& s : slabs) {
+        parents += s.parents;
+        uniform += s.uniform_parents;
+        blocks += s.blocks;
+        read += s.read_seconds;
+        compress += s.compress_seconds;
+        write += s.write_seconds;
+        if (!slowest || s.slowest_seconds > slowest->slowest_seconds) slowest = &s;
+    }
+    double voxels = static_cast<double>(run.x_count) * run.y_count * run.z_count;
+
+    out << "{\n";
+    out << "  \"model\": {\"x_count\": " << run.x_count << ", \"y_count\": " << run.y_count
+        << ", \"z_count\": " << run.z_count << ", \"parent_x\": " << run.parent_x << ", \"parent_y\": "
+        << run.parent_y << ", \"parent_z\": " << run.parent_z << ", \"voxels\": " << static_cast<std::uint64_t>(voxels)
+        << "},\n";
+    out << "  \"threads\": " << run.threads << ",\n";
+    out << "  \"strategy\": \"" << run.strategy << "\",\n";
+
+    // Read, compress and write overlap when pipelined, so they are thread
+    // time and may add up to more than the wall time
+    out << "  \"phases\": {\"header_s\": ";
+    write_number(out, run.header_seconds);
+    out << ", \"read_s\": ";
+    write_number(out, read);
+    out << ", \"compress_s\": ";
+    write_number(out, compress);
+    out << ", \"write_s\": ";
+    write_number(out, write);
+    out << ", \"wall_s\": ";
+    write_number(out, run.wall_seconds);
+    out << "},\n";
+
+    out << "  \"counters\": {\"parents_fixed\": " << counters.parents_fixed
+        << ", \"parents_grown\": " << counters.parents_grown << ", \"parent_decodes\": " << counters.parent_decodes
+        << ", \"fit_calls\": " << counters.fit_calls << ", \"fit_shrinks\": " << counters.fit_shrinks
+        << ", \"window_checks\": " << counters.window_checks << ", \"grow_steps\": " << counters.grow_steps
+        << "},\n";
+
+    out << "  \"totals\": {\"slabs\": " << slabs.size() << ", \"parents\": " << parents
+        << ", \"uniform_parents\": " << uniform << ", \"blocks\": " << blocks << ", \"blocks_per_parent\": ";
+    write_number(out, parents ? static_cast<double>(blocks) / parents : 0.0);
+    out << ", \"voxels_per_s\": ";
+    write_number(out, run.wall_seconds > 0.0 ? voxels / run.wall_seconds : 0.0);
+    out << ", \"blocks_per_s\": ";
+    write_number(out, run.wall_seconds > 0.0 ? blocks / run.wall_seconds : 0.0);
+    if (slowest) {
+        out << ", \"slowest_parent\": {\"x\": " << slowest->slowest_x << ", \"y\": " << slowest->slowest_y
+            << ", \"z\": " << slowest->top_slice << ", \"seconds\": ";
+        write_number(out, slowest->slowest_seconds);
+        out << ", \"blocks\": " << slowest->slowest_blocks << "}";
+    }
+    out << "},\n";
+
+    out << "  \"slabs\": [";
+    for (std::size_t i = 0; i < slabs.size(); ++i) {
+        const SlabStats& s = slabs[i];
+        out << (i ? ",\n" : "\n") << "    {\"top_slice\": " << s.top_slice << ", \"slices\": " << s.n_slices
+            << ", \"parents\": " << s.parents << ", \"uniform_parents\": " << s.uniform_parents
+            << ", \"blocks\": " << s.blocks << ", \"read_s\": ";
+        write_number(out, s.read_seconds);
+        out << ", \"compress_s\": ";
+        write_number(out, s.compress_seconds);
+        out << ", \"write_s\": ";
+        write_number(out, s.write_seconds);
+        out << ", \"slowest_parent\": {\"x\": " << s.slowest_x << ", \"y\": " << s.slowest_y << ", \"seconds\": ";
+        write_number(out, s.slowest_seconds);
+        out << ", \"blocks\": " << s.slowest_blocks << "}}";
+    }
+    out << (slabs.empty() ? "]\n" : "\n  ]\n");
+    out << "}\n";
+}
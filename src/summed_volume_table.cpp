@@ -0,0 +1,19 @@
+#include "summed_volume_table.h"
+
+void SummedVolumeTable::build(const Flat3DView<const char>& src, char tag) {
+    depth = src.depth;
+    height = src.height;
+    width = src.width;
+    data.assign(static_cast<std::size_t>(depth + 1) * (height + 1) * (width + 1), 0);
+
+    for (int z = 1; z <= depth; ++z)
+        for (int y = 1; y <= height; ++y) {
+            const char* src_row = &src.at(z - 1, y - 1, 0);
+            int row = 0;
+            for (int x = 1; x <= width; ++x) {
+                row += src_row[x - 1] == tag ? 1 : 0;
+                // Row prefix + the (z, y-1) and (z-1, y) planes, minus their overlap
+                at(z, y, x) = row + at(z, y - 1, x) + at(z - 1, y, x) - at(z - 1, y - 1, x);
+            }
+        }
+}
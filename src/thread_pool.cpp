@@ -0,0 +1,95 @@
+#include "thread_pool.h"
+
+ThreadPool::ThreadPool(unsigned int threads) {
+    unsigned int extra = threads > 1 ? threads - 1 : 0;
+    for (unsigned int i = 0; i <= extra; ++i)
+        queues.push_back(std::make_unique<Queue>());
+
+    workers.reserve(extra);
+    for (unsigned int i = 0; i < extra; ++i)
+        workers.emplace_back([this, i] { worker_loop(i + 1); });
+}
+
+ThreadPool::~ThreadPool() {
+    {
+        std::lock_guard<std::mutex> lock(mtx);
+        stopping = true;
+    }
+    cv.notify_all();
+    for (std::thread& t : workers)
+        t.join();
+}
+
+void ThreadPool::submit(TaskGroup& group, std::function<void()> task) {
+    group.pending.fetch_add(1, std::memory_order_relaxed);
+    Queue& q = *queues[next_queue.fetch_add(1, std::memory_order_relaxed) % queues.size()];
+    {
+        std::lock_guard<std::mutex> lock(q.mtx);
+        q.tasks.push_back(Task{&group, std::move(task)});
+    }
+    queued.fetch_add(1);
+
+    // Taking the lock orders this with a sleeper's check of 'queued'
+    { std::lock_guard<std::mutex> lock(mtx); }
+    cv.notify_one();
+}
+
+void ThreadPool::wait(TaskGroup& group) {
+    while (group.pending.load() != 0) {
+        if (try_run(0)) continue;
+
+        std::unique_lock<std::mutex> lock(mtx);
+        cv.wait(lock, [&] { return group.pending.load() == 0 || queued.load() != 0; });
+    }
+
+    std::exception_ptr error;
+    {
+        std::lock_guard<std::mutex> lock(group.error_mtx);
+        std::swap(error, group.error);
+    }
+    if (error) std::rethrow_exception(error);
+}
+
+void ThreadPool::worker_loop(std::size_t self) {
+    while (true) {
+        if (try_run(self)) continue;
+
+        std::unique_lock<std::mutex> lock(mtx);
+        cv.wait(lock, [this] { return stopping || queued.load() != 0; });
+        if (stopping) return;
+    }
+}
+
+// Runs the oldest task of queue 'self', else steals the oldest task of the
+// next non-empty queue. False if every queue was empty.
+bool ThreadPool::try_run(std::size_t self) {
+    for (std::size_t i = 0; i < queues.size(); ++i) {
+        Queue& q = *queues[(self + i) % queues.size()];
+        Task task;
+        {
+            std::lock_guard<std::mutex> lock(q.mtx);
+            if (q.tasks.empty()) continue;
+            task = std::move(q.tasks.front());
+            q.tasks.pop_front();
+        }
+        queued.fetch_sub(1);
+        run(task);
+        return true;
+    }
+    return false;
+}
+
+void ThreadPool::run(Task& task) {
+    try {
+        task.fn();
+    } catch (...) {
+        std::lock_guard<std::mutex> lock(task.group->error_mtx);
+        if (!task.group->error) task.group->error = std::current_exception();
+    }
+
+    if (task.group->pending.fetch_sub(1) == 1) {
+        // Wake whoever waits on the group
+        { std::lock_guard<std::mutex> lock(mtx); }
+        cv.notify_all();
+    }
+}
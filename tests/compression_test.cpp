@@ -1,11 +1,28 @@
+#include "binary_format.h"
+#include "block_compressor.h"
 #include "block_model.h"
+#include "block_validator.h"
+#include "checkpoint.h"
+#include "fixed_growth.h"
+#include "packed_slab.h"
+#include "row_kernels.h"
 #include <cassert>
+#include <cstdio>
+#include <filesystem>
 #include <fstream>
 #include <iostream>
+#include <iterator>
+#include <random>
 #include <sstream>
+#include <stdexcept>
 #include <string>
+#include <utility>
 #include <vector>
 
+#ifdef __linux__
+#include <sys/resource.h>
+#endif
+
 // Test the compression functionality directly
 class CompressionTest {
 public:
@@ -15,6 +32,28 @@ public:
     test_basic_compression();
     test_case1_compression();
     test_case2_compression();
+    test_parallel_matches_serial();
+    test_many_small_parents();
+    test_work_stealing_pool();
+    test_pipeline_error();
+    test_uniform_parent_blocks();
+    test_rle_slab();
+    test_packed_slab();
+    test_block_merger();
+    test_alternative_strategies();
+    test_fixed_growth();
+    test_block_compressor();
+    test_stats_report();
+    test_block_validator();
+    test_checkpoint_resume();
+    test_summed_volume_table();
+    test_largest_box_growth();
+    test_bit3d();
+    test_row_kernels();
+    test_line_reader();
+    test_mapped_input();
+    test_text_block_buffer();
+    test_binary_round_trip();
 
     std::cout << "All compression tests passed!\n";
   }
@@ -126,6 +165,1049 @@ private:
     std::cin.rdbuf(orig);
     case2_file.close();
   }
+
+  // Compress a case file with the given settings and return the output
+  static std::string
+  compress_file(const std::string& path, unsigned int threads,
+                GrowthStrategy strategy = GrowthStrategy::Greedy,
+                OutputFormat format = OutputFormat::Text,
+                SlabEncoding encoding = SlabEncoding::Dense,
+                MergeMode merge = MergeMode::None) {
+    std::ifstream file(path);
+    if (!file.is_open()) {
+      throw std::runtime_error("Could not open " + path);
+    }
+
+    std::streambuf* orig = std::cin.rdbuf();
+    std::streambuf* cout_orig = std::cout.rdbuf();
+    std::ostringstream output;
+    std::cin.rdbuf(file.rdbuf());
+    std::cout.rdbuf(output.rdbuf());
+
+    try {
+      BlockModel bm;
+      bm.set_num_threads(threads);
+      bm.set_growth_strategy(strategy);
+      bm.set_output_format(format);
+      bm.set_slab_encoding(encoding);
+      bm.set_merge_mode(merge);
+      bm.read_specification();
+      bm.read_tag_table();
+      bm.read_model();
+    } catch (...) {
+      std::cin.rdbuf(orig);
+      std::cout.rdbuf(cout_orig);
+      throw;
+    }
+
+    std::cin.rdbuf(orig);
+    std::cout.rdbuf(cout_orig);
+    return output.str();
+  }
+
+  static void test_parallel_matches_serial() {
+    std::cout << "Testing parallel compression matches serial...\n";
+
+    for (const char* path : {"tests/data/case1.txt", "tests/data/case2.txt"}) {
+      std::string serial = compress_file(path, 1);
+      std::string parallel = compress_file(path, 4);
+      if (serial.empty() || serial != parallel) {
+        throw std::runtime_error(std::string("Parallel output differs for ") +
+                                 path);
+      }
+    }
+
+    std::cout << "✓ Parallel compression test passed\n";
+  }
+
+  static void test_many_small_parents() {
+    std::cout << "Testing memory with many small parent blocks...\n";
+
+    // 256 x 256 x 8 in 2x2x2 parents: 16384 parents in each of 4 slabs
+    std::string path = std::filesystem::temp_directory_path().string() +
+                       "/block_model_small_parents.txt";
+    {
+      std::ofstream model(path, std::ios::binary);
+      model << "256,256,8,2,2,2\no, sea\nw, WA\n\n";
+      for (int z = 0; z < 8; ++z) {
+        for (int y = 0; y < 256; ++y) {
+          for (int x = 0; x < 256; ++x) {
+            model << ((x * 7 + y * 13 + z * 5) % 11 < 3 ? 'w' : 'o');
+          }
+          model << "\n";
+        }
+        if (z < 7) model << "\n";
+      }
+    }
+
+    SlabParents parents;
+    parents.reset(ModelSpec{256, 256, 8, 2, 2, 2}, 0, 2);
+    if (parents.size() != 16384 || parents.run_count() > 64) {
+      throw std::runtime_error("Small parents are not batched into runs");
+    }
+
+    std::string serial = compress_file(path, 1);
+    std::istringstream binary(compress_file(path, 4, GrowthStrategy::Greedy,
+                                            OutputFormat::Binary));
+    std::ostringstream decoded;
+    binary_to_text(binary, decoded);
+    if (compress_file(path, 4) != serial || decoded.str() != serial) {
+      throw std::runtime_error("Parallel output differs for small parents");
+    }
+    std::remove(path.c_str());
+
+#ifdef __linux__
+    // One output buffer per parent per slab in flight used to reach GBs
+    rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    if (usage.ru_maxrss > 256 * 1024) {
+      throw std::runtime_error("Peak memory " +
+                               std::to_string(usage.ru_maxrss / 1024) +
+                               " MB for a 0.5 MB model");
+    }
+#endif
+
+    std::cout << "✓ Small parent block memory test passed\n";
+  }
+
+  static void test_work_stealing_pool() {
+    std::cout << "Testing work-stealing thread pool...\n";
+
+    ThreadPool pool(4);
+    TaskGroup first, second;
+    std::vector<int> done(200, 0);
+    for (int i = 0; i < 200; ++i) {
+      // Uneven task costs, split over two groups that are in flight together
+      pool.submit(i < 100 ? first : second, [&done, i] {
+        volatile long spin = 0;
+        for (long k = 0; k < (i % 10 == 0 ? 200000 : 100); ++k) spin = spin + k;
+        done[i] = 1;
+      });
+    }
+    pool.wait(first);
+    for (int i = 0; i < 100; ++i) {
+      if (!done[i]) throw std::runtime_error("Task group finished early");
+    }
+    pool.wait(second);
+    for (int v : done) {
+      if (!v) throw std::runtime_error("Pool task did not run");
+    }
+
+    TaskGroup failing;
+    pool.submit(failing, [] { throw std::runtime_error("task failed"); });
+    pool.submit(failing, [] {});
+    bool threw = false;
+    try {
+      pool.wait(failing);
+    } catch (const std::runtime_error&) {
+      threw = true;
+    }
+    if (!threw) {
+      throw std::runtime_error("Pool task exception was not rethrown");
+    }
+
+    std::cout << "✓ Work-stealing thread pool test passed\n";
+  }
+
+  static void test_pipeline_error() {
+    std::cout << "Testing pipelined read error...\n";
+
+    // case1 with its last model row cut short: the error is raised on the
+    // reader thread and must reach the caller
+    std::ifstream file("tests/data/case1.txt");
+    std::string input((std::istreambuf_iterator<char>(file)),
+                      std::istreambuf_iterator<char>());
+    std::size_t last_row = input.find_last_of('\n', input.size() - 2);
+    std::string truncated = input.substr(0, last_row + 10) + "\n";
+
+    bool threw = false;
+    try {
+      compress_text(truncated, 4);
+    } catch (const std::runtime_error&) {
+      threw = true;
+    }
+
+    if (!threw) {
+      throw std::runtime_error("Pipelined read error was not propagated");
+    }
+
+    std::cout << "✓ Pipelined read error test passed\n";
+  }
+
+  // Compresses an in-memory input on the given number of threads
+  static std::string compress_text(const std::string& input,
+                                   unsigned int threads) {
+    std::istringstream in(input);
+    std::streambuf* orig = std::cin.rdbuf();
+    std::streambuf* cout_orig = std::cout.rdbuf();
+    std::ostringstream output;
+    std::cin.rdbuf(in.rdbuf());
+    std::cout.rdbuf(output.rdbuf());
+
+    try {
+      BlockModel bm;
+      bm.set_num_threads(threads);
+      bm.read_specification();
+      bm.read_tag_table();
+      bm.read_model();
+    } catch (...) {
+      std::cin.rdbuf(orig);
+      std::cout.rdbuf(cout_orig);
+      throw;
+    }
+
+    std::cin.rdbuf(orig);
+    std::cout.rdbuf(cout_orig);
+    return output.str();
+  }
+
+  static void test_uniform_parent_blocks() {
+    std::cout << "Testing uniform parent block fast path...\n";
+
+    // 4x4x4 of 'o' in 2x2x2 parents, with one 'w' in the very last cell read
+    // for the final parent block
+    std::string input = "4,4,4,2,2,2\no, sea\nw, WA\n\n";
+    for (int z = 0; z < 4; ++z) {
+      for (int y = 0; y < 4; ++y) {
+        input += (z == 3 && y == 3) ? "ooow\n" : "oooo\n";
+      }
+      if (z < 3) input += "\n";
+    }
+
+    for (unsigned int threads : {1u, 3u}) {
+      std::string output = compress_text(input, threads);
+      int blocks = 0;
+      if (total_volume(output, blocks) != 64 ||
+          output.find("0,0,0,2,2,2,sea\n") != 0 ||
+          output.find("2,2,2,2,2,2,sea\n") != std::string::npos ||
+          output.find("3,3,3,1,1,1,WA\n") == std::string::npos) {
+        throw std::runtime_error("Uniform parent blocks compressed wrongly");
+      }
+    }
+
+    std::cout << "✓ Uniform parent block test passed\n";
+  }
+
+  // Sum of width * height * depth over every output line; counts lines too
+  static long long total_volume(const std::string& output, int& blocks) {
+    std::istringstream in(output);
+    std::string line;
+    long long volume = 0;
+    blocks = 0;
+    while (std::getline(in, line)) {
+      int x, y, z, w, h, d;
+      char c;
+      std::istringstream fields(line);
+      fields >> x >> c >> y >> c >> z >> c >> w >> c >> h >> c >> d;
+      volume += static_cast<long long>(w) * h * d;
+      ++blocks;
+    }
+    return volume;
+  }
+
+  static void test_largest_box_growth() {
+    std::cout << "Testing largest-box growth strategy...\n";
+
+    int greedy_blocks = 0, largest_blocks = 0;
+    long long greedy_volume =
+        total_volume(compress_file("tests/data/case2.txt", 1), greedy_blocks);
+    long long largest_volume = total_volume(
+        compress_file("tests/data/case2.txt", 1, GrowthStrategy::LargestBox),
+        largest_blocks);
+
+    if (largest_volume != 64 * 16 * 5 || greedy_volume != largest_volume ||
+        largest_blocks > greedy_blocks) {
+      throw std::runtime_error("Largest-box growth lost or added volume");
+    }
+
+    std::cout << "✓ Largest-box growth test passed - " << largest_blocks
+              << " blocks (greedy " << greedy_blocks << ")\n";
+  }
+
+  // Label of every cell covered by the output's blocks; throws on overlaps
+  static std::vector<std::string> paint(const std::string& output, int nx,
+                                        int ny, int nz) {
+    std::vector<std::string> cells(static_cast<std::size_t>(nx) * ny * nz);
+    std::istringstream in(output);
+    std::string line;
+    while (std::getline(in, line)) {
+      int x, y, z, w, h, d;
+      char c;
+      std::string label;
+      std::istringstream fields(line);
+      fields >> x >> c >> y >> c >> z >> c >> w >> c >> h >> c >> d >> c;
+      std::getline(fields, label);
+      for (int k = z; k < z + d; ++k)
+        for (int j = y; j < y + h; ++j)
+          for (int i = x; i < x + w; ++i) {
+            std::string& cell = cells[(static_cast<std::size_t>(k) * ny + j) * nx + i];
+            if (!cell.empty()) throw std::runtime_error("Blocks overlap: " + line);
+            cell = label;
+          }
+    }
+    return cells;
+  }
+
+  static void test_alternative_strategies() {
+    std::cout << "Testing scanline and octree strategies...\n";
+
+    struct Case {
+      const char* path;
+      int nx, ny, nz;
+    };
+    for (const Case& c : {Case{"tests/data/case1.txt", 64, 8, 5},
+                          Case{"tests/data/case2.txt", 64, 16, 5}}) {
+      std::vector<std::string> expected =
+          paint(compress_file(c.path, 1), c.nx, c.ny, c.nz);
+      for (GrowthStrategy strategy :
+           {GrowthStrategy::Scanline, GrowthStrategy::Octree}) {
+        for (unsigned int threads : {1u, 4u}) {
+          if (paint(compress_file(c.path, threads, strategy), c.nx, c.ny,
+                    c.nz) != expected) {
+            throw std::runtime_error(std::string("Strategy output does not "
+                                                 "match the model for ") +
+                                     c.path);
+          }
+        }
+      }
+    }
+
+    std::cout << "✓ Scanline and octree strategies test passed\n";
+  }
+
+  // Reads a case file into memory: spec, tag table and z, y, x ordered tags
+  static std::vector<char>
+  load_model(const std::string& path, ModelSpec& spec,
+             std::unordered_map<char, std::string>& tag_table) {
+    std::ifstream file(path);
+    if (!file.is_open()) {
+      throw std::runtime_error("Could not open " + path);
+    }
+    std::string line;
+    std::getline(file, line);
+    char comma;
+    std::istringstream(line) >> spec.x_count >> comma >> spec.y_count >>
+        comma >> spec.z_count >> comma >> spec.parent_x >> comma >>
+        spec.parent_y >> comma >> spec.parent_z;
+    while (std::getline(file, line) && !line.empty()) {
+      tag_table[line[0]] = line.substr(3);
+    }
+    std::vector<char> voxels;
+    while (std::getline(file, line)) {
+      voxels.insert(voxels.end(), line.begin(), line.end());
+    }
+    return voxels;
+  }
+
+  static std::string format_blocks(const std::vector<Block>& blocks,
+                                   const LabelTable& labels) {
+    TextBlockBuffer text(labels);
+    for (const Block& b : blocks) {
+      text.emit(b);
+    }
+    return std::string(text.data(), text.size());
+  }
+
+  static void test_block_compressor() {
+    std::cout << "Testing in-memory compression API...\n";
+
+    ModelSpec spec;
+    std::unordered_map<char, std::string> tag_table;
+    std::vector<char> voxels =
+        load_model("tests/data/case2.txt", spec, tag_table);
+    LabelTable labels(tag_table);
+    std::size_t plane = static_cast<std::size_t>(spec.y_count) * spec.x_count;
+    if (voxels.size() != plane * spec.z_count) {
+      throw std::runtime_error("Could not load case2.txt");
+    }
+
+    // Whole model at once matches the command-line output
+    std::string expected = compress_file("tests/data/case2.txt", 1);
+    if (format_blocks(compress_model(spec, tag_table, voxels.data()), labels) !=
+        expected) {
+      throw std::runtime_error("compress_model output differs from BlockModel");
+    }
+
+    // One slice at a time into a callback, on two threads
+    std::vector<Block> pushed;
+    CallbackSink callback([&](const Block& b) { pushed.push_back(b); });
+    BlockCompressor compressor(spec, tag_table, callback);
+    compressor.set_num_threads(2);
+    for (int z = 0; z < spec.z_count; ++z) {
+      compressor.push_slices(&voxels[z * plane], 1);
+    }
+    compressor.finish();
+    if (format_blocks(pushed, compressor.labels()) != expected) {
+      throw std::runtime_error("Slice-by-slice output differs from BlockModel");
+    }
+
+    // Uneven pushes with the merge pass
+    BlockList merged;
+    BlockCompressor merging(spec, tag_table, merged);
+    merging.set_merge_mode(MergeMode::Z);
+    merging.push_slices(voxels.data(), 1);
+    merging.push_slices(&voxels[plane], spec.z_count - 1);
+    merging.finish();
+    if (format_blocks(merged.blocks, labels) !=
+        compress_file("tests/data/case2.txt", 1, GrowthStrategy::Greedy,
+                      OutputFormat::Text, SlabEncoding::Dense, MergeMode::Z)) {
+      throw std::runtime_error("Merged output differs from BlockModel");
+    }
+
+    // Missing or extra slices and a bad spec are reported
+    BlockList unused;
+    BlockCompressor partial(spec, tag_table, unused);
+    partial.push_slices(voxels.data(), 1);
+    bool threw = false;
+    try {
+      partial.finish();
+    } catch (const std::runtime_error&) {
+      threw = true;
+    }
+    try {
+      partial.push_slices(voxels.data(), spec.z_count);
+      threw = false;
+    } catch (const std::runtime_error&) {
+    }
+    try {
+      BlockCompressor bad(ModelSpec(), tag_table, unused);
+      threw = false;
+    } catch (const std::runtime_error&) {
+    }
+    if (!threw) {
+      throw std::runtime_error("Invalid use of BlockCompressor not reported");
+    }
+
+    std::cout << "✓ In-memory compression API test passed\n";
+  }
+
+  static void test_stats_report() {
+#if BLOCK_STATS
+    std::cout << "Testing --stats report...\n";
+
+    for (unsigned int threads : {1u, 3u}) {
+      std::ifstream file("tests/data/case2.txt");
+      std::ostringstream output, report;
+      std::streambuf* orig = std::cin.rdbuf(file.rdbuf());
+      std::streambuf* cout_orig = std::cout.rdbuf(output.rdbuf());
+      std::streambuf* cerr_orig = std::cerr.rdbuf(report.rdbuf());
+      try {
+        BlockModel bm;
+        bm.set_num_threads(threads);
+        bm.set_collect_stats(true);
+        bm.read_specification();
+        bm.read_tag_table();
+        bm.read_model();
+      } catch (...) {
+        std::cin.rdbuf(orig);
+        std::cout.rdbuf(cout_orig);
+        std::cerr.rdbuf(cerr_orig);
+        throw;
+      }
+      std::cin.rdbuf(orig);
+      std::cout.rdbuf(cout_orig);
+      std::cerr.rdbuf(cerr_orig);
+
+      // case2 is 8 x 2 parents per slab in 3 slabs, compressed to 124 blocks
+      std::string json = report.str();
+      if (output.str() != compress_file("tests/data/case2.txt", 1) ||
+          json.find("\"slabs\": 3, \"parents\": 48,") == std::string::npos ||
+          json.find("\"blocks\": 124,") == std::string::npos ||
+          json.find("\"top_slice\": 4, \"slices\": 1,") == std::string::npos) {
+        throw std::runtime_error("Unexpected statistics report:\n" + json);
+      }
+    }
+
+    std::cout << "✓ Statistics report test passed\n";
+#endif
+  }
+
+  // Validates output against case2.txt on the given number of threads
+  static ValidationReport validate_case2(const std::string& output,
+                                         unsigned int threads,
+                                         bool allow_merged = false) {
+    std::ifstream model("tests/data/case2.txt");
+    std::istringstream blocks(output);
+    BlockValidator validator(model);
+    validator.set_num_threads(threads);
+    validator.set_allow_parent_crossing(allow_merged);
+    return validator.validate(blocks);
+  }
+
+  static void test_block_validator() {
+    std::cout << "Testing streaming validator...\n";
+
+    std::string output = compress_file("tests/data/case2.txt", 1);
+    std::string binary = compress_file("tests/data/case2.txt", 1,
+                                       GrowthStrategy::Greedy,
+                                       OutputFormat::Binary);
+    std::string merged = compress_file(
+        "tests/data/case2.txt", 1, GrowthStrategy::Greedy, OutputFormat::Text,
+        SlabEncoding::Dense, MergeMode::XYZ);
+    for (unsigned int threads : {1u, 3u}) {
+      ValidationReport ok = validate_case2(output, threads);
+      if (!ok.ok() || ok.blocks != 124 || ok.covered_voxels != 64 * 16 * 5 ||
+          !validate_case2(binary, threads).ok() ||
+          !validate_case2(merged, threads, true).ok()) {
+        throw std::runtime_error("Valid output was rejected");
+      }
+    }
+
+    // Dropping the first block leaves a gap; repeating it overlaps
+    std::string first = output.substr(0, output.find('\n') + 1);
+    Block b(0, 0, 0, 0, 0, 0, 'o');
+    std::sscanf(first.c_str(), "%d,%d,%d,%d,%d,%d", &b.x, &b.y, &b.z, &b.width,
+                &b.height, &b.depth);
+    int volume = b.width * b.height * b.depth;
+    ValidationReport gap = validate_case2(output.substr(first.size()), 2);
+    ValidationReport overlap = validate_case2(output + first, 2);
+    if (gap.ok() || gap.gap_voxels != static_cast<std::uint64_t>(volume) ||
+        overlap.ok() ||
+        overlap.overlap_voxels != static_cast<std::uint64_t>(volume)) {
+      throw std::runtime_error("Gap or overlap not detected");
+    }
+
+    // Relabelling a block is a mismatch; merged blocks cross parents
+    std::string relabelled = output;
+    std::size_t label = relabelled.rfind(',', first.size()) + 1;
+    relabelled.replace(label, first.size() - 1 - label,
+                       first.find("sea") == std::string::npos ? "sea" : "WA");
+    if (validate_case2(relabelled, 1).mismatch_voxels !=
+            static_cast<std::uint64_t>(volume) ||
+        validate_case2(merged, 1).parent_crossings == 0) {
+      throw std::runtime_error("Mislabelled or merged blocks not detected");
+    }
+
+    std::cout << "✓ Streaming validator test passed\n";
+  }
+
+  static std::string read_file(const std::string& path) {
+    std::ifstream in(path, std::ios::binary);
+    return std::string(std::istreambuf_iterator<char>(in),
+                       std::istreambuf_iterator<char>());
+  }
+
+  static void write_file(const std::string& path, const std::string& data) {
+    std::ofstream out(path, std::ios::binary | std::ios::trunc);
+    out << data;
+  }
+
+  static void compress_with_checkpoint(const std::string& input,
+                                       const std::string& output,
+                                       const std::string& checkpoint,
+                                       unsigned int threads, bool resume,
+                                       OutputFormat format = OutputFormat::Text,
+                                       GrowthStrategy growth = GrowthStrategy::Greedy) {
+    BlockModel bm;
+    bm.set_num_threads(threads);
+    bm.set_output_format(format);
+    bm.set_growth_strategy(growth);
+    bm.set_input_file(input);
+    bm.set_output_file(output);
+    bm.set_checkpoint(checkpoint, 1);
+    bm.set_resume(resume);
+    bm.read_specification();
+    bm.read_tag_table();
+    bm.read_model();
+  }
+
+  static void test_checkpoint_resume() {
+    std::cout << "Testing checkpoint and resume...\n";
+
+    std::string dir = std::filesystem::temp_directory_path().string();
+    std::string input = dir + "/block_model_resume_in.txt";
+    std::string output = dir + "/block_model_resume_out.txt";
+    std::string checkpoint = dir + "/block_model_resume.ckpt";
+    std::string plain = read_file("tests/data/case2.txt");
+    std::string expected = compress_file("tests/data/case2.txt", 1);
+
+    // The same model with its first row ending in CRLF, so the mapped
+    // layout of the resumed slab differs from the first one's
+    std::string crlf = plain;
+    crlf.insert(crlf.find('\n', crlf.find("\n\n") + 2), "\r");
+
+    for (const std::string& model : {plain, crlf}) {
+      // Moving the last line break one column left leaves a short row in
+      // the last of case2's three slabs, which stops the run after two
+      // slabs are written and checkpointed
+      std::string broken = model;
+      std::size_t last_break = model.rfind('\n', model.size() - 2);
+      broken[last_break - 1] = '\n';
+      broken[last_break] = 'o';
+      write_file(input, broken);
+      bool threw = false;
+      try {
+        compress_with_checkpoint(input, output, checkpoint, 1, false);
+      } catch (const std::runtime_error&) {
+        threw = true;
+      }
+      Checkpoint cp = Checkpoint::load(checkpoint);
+      if (!threw || cp.slabs_done != 2 ||
+          read_file(output).compare(0, cp.output_offset, expected, 0,
+                                    cp.output_offset) != 0) {
+        throw std::runtime_error("Checkpoint does not match the output so far");
+      }
+
+      // Bytes written after the checkpoint are dropped on resume
+      write_file(output, read_file(output) + "partial,");
+      write_file(input, model);
+
+      // Resuming with another format or strategy would append blocks the
+      // earlier output does not match, so it is refused before any change
+      std::string interrupted = read_file(output);
+      for (int mismatch = 0; mismatch < 2; ++mismatch) {
+        threw = false;
+        try {
+          compress_with_checkpoint(input, output, checkpoint, 1, true,
+                                   mismatch ? OutputFormat::Text : OutputFormat::Binary,
+                                   mismatch ? GrowthStrategy::Scanline : GrowthStrategy::Greedy);
+        } catch (const std::runtime_error&) {
+          threw = true;
+        }
+        if (!threw || read_file(output) != interrupted) {
+          throw std::runtime_error("Resume with different options was not refused");
+        }
+      }
+
+      compress_with_checkpoint(input, output, checkpoint, 4, true);
+      cp = Checkpoint::load(checkpoint);
+      if (read_file(output) != expected || cp.slabs_done != 3 ||
+          cp.output_offset != expected.size()) {
+        throw std::runtime_error("Resumed output differs");
+      }
+    }
+
+    for (const std::string& path : {input, output, checkpoint})
+      std::remove(path.c_str());
+    std::cout << "✓ Checkpoint and resume test passed\n";
+  }
+
+  static void test_fixed_growth() {
+    std::cout << "Testing size-specialised greedy growth...\n";
+
+    LabelTable labels;
+    std::mt19937 rng(42);
+    int sizes[][3] = {{4, 4, 4}, {8, 8, 8}, {8, 8, 2}, {4, 4, 8}};
+    for (auto& size : sizes) {
+      for (int round = 0; round < 50; ++round) {
+        // Mostly 'o' with clumps of other tags, denser in later rounds
+        Flat3D<char> grid(size[2], size[1], size[0], 'o');
+        for (char& c : grid.data) {
+          if (static_cast<int>(rng() % 100) < round) c = "wxy"[rng() % 3];
+        }
+
+        Block parent(16, 8, 4, size[0], size[1], size[2], grid.at(0, 0, 0));
+        TextBlockBuffer generic(labels), fixed(labels);
+        BlockGrowth growth(grid, GrowthStrategy::Greedy);
+        growth.run(parent, generic);
+        if (!run_fixed_growth(grid, parent, fixed) ||
+            std::string(generic.data(), generic.size()) !=
+                std::string(fixed.data(), fixed.size())) {
+          throw std::runtime_error("Specialised growth differs from BlockGrowth");
+        }
+      }
+    }
+
+    Flat3D<char> odd(5, 5, 5, 'o');
+    TextBlockBuffer unused(labels);
+    if (run_fixed_growth(odd, Block(0, 0, 0, 5, 5, 5, 'o'), unused) ||
+        unused.size() != 0) {
+      throw std::runtime_error("Unspecialised size was not left to BlockGrowth");
+    }
+
+    std::cout << "✓ Size-specialised greedy growth test passed\n";
+  }
+
+  static void test_bit3d() {
+    std::cout << "Testing bit-packed mask...\n";
+
+    Bit3D bits(2, 3, 300);
+    bits.set_window(0, 2, 1, 2, 60, 290);
+    bits.set(1, 2, 5);
+
+    if (!bits.test(0, 1, 60) || !bits.test(1, 1, 289) || bits.test(0, 1, 59) ||
+        bits.test(1, 1, 290) || !bits.row_any(0, 1, 0, 61) ||
+        bits.row_any(0, 1, 290, 300) || bits.row_any(0, 0, 0, 300) ||
+        bits.row_find_set(1, 1, 0, 300) != 60 ||
+        bits.row_find_set(1, 2, 6, 300) != 300 ||
+        bits.row_find_set(1, 2, 0, 3) != 3 || !bits.any(1, 2, 2, 3, 0, 6) ||
+        bits.any(0, 2, 0, 3, 290, 300)) {
+      throw std::runtime_error("Bit-packed mask reports wrong bits");
+    }
+
+    std::cout << "✓ Bit-packed mask test passed\n";
+  }
+
+  static void test_row_kernels() {
+    std::cout << "Testing row kernels (" << row_kernels_isa() << ")...\n";
+
+    std::string row(100, 'o');
+    for (int pos : {0, 5, 15, 16, 31, 32, 47, 70, 99}) {
+      std::string r = row;
+      r[pos] = 'w';
+      for (int n : {1, 15, 16, 17, 33, 64, 100}) {
+        int mismatch = pos < n ? pos : n;
+        int matches = n - (pos < n ? 1 : 0);
+        if (row_find_mismatch(r.data(), n, 'o') != mismatch ||
+            row_find_match(r.data(), n, 'w') != mismatch ||
+            row_count_matches(r.data(), n, 'o') != matches) {
+          throw std::runtime_error("Row kernel result is wrong");
+        }
+      }
+    }
+
+    std::cout << "✓ Row kernels test passed\n";
+  }
+
+  static void test_line_reader() {
+    std::cout << "Testing buffered line reader...\n";
+
+    std::string long_line(100, 'o');
+    std::istringstream in("64,8,5\r\n\n" + long_line + "\r\nlast");
+    LineReader reader(in, 8); // tiny buffer forces refills and growth
+
+    std::vector<std::string> expected = {"64,8,5", "", long_line, "last"};
+    const char* line;
+    std::size_t len;
+    for (const std::string& want : expected) {
+      if (!reader.next_line(line, len) || std::string(line, len) != want) {
+        throw std::runtime_error("Line reader returned the wrong line");
+      }
+    }
+    if (reader.next_line(line, len) || len != 0) {
+      throw std::runtime_error("Line reader did not stop at end of input");
+    }
+
+    // Specification fields are positive ints; -2147483648 parses but is
+    // not positive, +2147483648 does not fit
+    std::streambuf* orig = std::cin.rdbuf();
+    std::pair<const char*, const char*> specs[] = {
+        {"2147483647,1,1,1,1,1", ""},
+        {"-2147483648,1,1,1,1,1", "positive"},
+        {"2147483648,1,1,1,1,1", "out of range"},
+        {"+2147483648,1,1,1,1,1", "out of range"},
+        {"64,16,5,8,8,0", "positive"},
+        {"64,16,5,0,8,2", "positive"}};
+    for (const auto& spec : specs) {
+      std::istringstream in(std::string(spec.first) + "\n");
+      std::cin.rdbuf(in.rdbuf());
+      std::string error;
+      try {
+        BlockModel bm;
+        bm.read_specification();
+      } catch (const std::runtime_error& e) {
+        error = e.what();
+      }
+      std::cin.rdbuf(orig);
+      if (*spec.second ? error.find(spec.second) == std::string::npos : !error.empty()) {
+        throw std::runtime_error(std::string("Specification parsing mishandled ") + spec.first);
+      }
+    }
+
+    std::cout << "✓ Buffered line reader test passed\n";
+  }
+
+  static std::string compress_mapped(const std::string& path) {
+    std::streambuf* cout_orig = std::cout.rdbuf();
+    std::ostringstream output;
+    std::cout.rdbuf(output.rdbuf());
+    try {
+      BlockModel bm;
+      bm.set_num_threads(1);
+      bm.set_input_file(path);
+      bm.read_specification();
+      bm.read_tag_table();
+      bm.read_model();
+    } catch (...) {
+      std::cout.rdbuf(cout_orig);
+      throw;
+    }
+    std::cout.rdbuf(cout_orig);
+    return output.str();
+  }
+
+  static void test_mapped_input() {
+    std::cout << "Testing memory-mapped input...\n";
+
+    for (const char* path : {"tests/data/case1.txt", "tests/data/case2.txt"}) {
+      if (compress_mapped(path) != compress_file(path, 1)) {
+        throw std::runtime_error(std::string("Mapped output differs for ") +
+                                 path);
+      }
+    }
+
+    // Rows whose line ends sit where a uniform layout expects them, but
+    // which the line reader rejects: a row split in two by a line break,
+    // and a row ending in '\r' before its LF. Both paths must refuse them.
+    std::string model = read_file("tests/data/case2.txt");
+    std::size_t row = model.find('\n', model.find("\n\n") + 2) + 1;
+    std::string split = model, carriage = model;
+    split[row + 20] = '\n';
+    carriage[row + 63] = '\r';
+    std::string path = std::filesystem::temp_directory_path().string() +
+                       "/block_model_mapped_rows.txt";
+    for (const std::string& bad : {split, carriage}) {
+      write_file(path, bad);
+      bool mapped_threw = false, stream_threw = false;
+      try {
+        compress_mapped(path);
+      } catch (const std::runtime_error&) {
+        mapped_threw = true;
+      }
+      try {
+        compress_file(path, 1);
+      } catch (const std::runtime_error&) {
+        stream_threw = true;
+      }
+      if (!mapped_threw || !stream_threw) {
+        throw std::runtime_error("Mapped and streamed input disagree on a bad row");
+      }
+    }
+    std::remove(path.c_str());
+
+    std::cout << "✓ Memory-mapped input test passed\n";
+  }
+
+  static void test_text_block_buffer() {
+    std::cout << "Testing text block buffer...\n";
+
+    LabelTable labels({{'o', "sea"}, {'w', "WA"}});
+    TextBlockBuffer out(labels);
+    out.emit(Block(0, 10, 2147483647, 1, 20, 300, 'o'));
+    out.emit(Block(-5, 0, 7, 4000, 1, 1, 'x')); // unknown tag prints itself
+
+    std::string expected = "0,10,2147483647,1,20,300,sea\n-5,0,7,4000,1,1,x\n";
+    if (std::string(out.data(), out.size()) != expected) {
+      throw std::runtime_error("Text block buffer formatted blocks wrongly");
+    }
+
+    out.clear();
+    std::string many;
+    for (int i = 0; i < 10000; ++i) { // outgrows the initial buffer
+      out.emit(Block(i, 0, 0, 1, 1, 1, 'w'));
+      many += std::to_string(i) + ",0,0,1,1,1,WA\n";
+    }
+    if (std::string(out.data(), out.size()) != many) {
+      throw std::runtime_error("Text block buffer lost output while growing");
+    }
+
+    std::cout << "✓ Text block buffer test passed\n";
+  }
+
+  static void test_binary_round_trip() {
+    std::cout << "Testing binary output round trip...\n";
+
+    for (const char* path : {"tests/data/case1.txt", "tests/data/case2.txt"}) {
+      std::string text = compress_file(path, 1);
+      for (unsigned int threads : {1u, 4u}) {
+        std::istringstream binary(compress_file(
+            path, threads, GrowthStrategy::Greedy, OutputFormat::Binary));
+        std::ostringstream decoded;
+        binary_to_text(binary, decoded);
+        if (decoded.str() != text) {
+          throw std::runtime_error(std::string("Binary round trip differs for ") +
+                                   path);
+        }
+      }
+    }
+
+    std::istringstream binary(compress_file(
+        "tests/data/case1.txt", 1, GrowthStrategy::Greedy, OutputFormat::Binary));
+    BinaryBlockReader reader(binary);
+    const BinaryHeader& header = reader.header();
+    if (header.x_count != 64 || header.parent_z != 4 || header.tags.empty()) {
+      throw std::runtime_error("Binary header does not match the input");
+    }
+
+    std::istringstream truncated(binary.str().substr(0, binary.str().size() - 1));
+    bool threw = false;
+    try {
+      std::ostringstream sink;
+      binary_to_text(truncated, sink);
+    } catch (const std::runtime_error&) {
+      threw = true;
+    }
+    if (!threw) {
+      throw std::runtime_error("Truncated binary stream was not rejected");
+    }
+
+    std::cout << "✓ Binary output round trip test passed\n";
+  }
+
+  static void test_rle_slab() {
+    std::cout << "Testing run-length encoded slabs...\n";
+
+    RleSlab runs;
+    runs.reset(2, 2, 40);
+    std::string rows[4] = {std::string(40, 'o'),
+                           std::string(10, 'o') + std::string(20, 'w') +
+                               std::string(10, 'o'),
+                           std::string(39, 'o') + "w", std::string(40, 'w')};
+    for (const std::string& row : rows) runs.append_row(row.data());
+
+    if (runs.run_count() != 7 || runs.tag_at(0, 1, 9) != 'o' ||
+        runs.tag_at(0, 1, 10) != 'w' || runs.tag_at(1, 0, 39) != 'w' ||
+        runs.run_end(0, 1, runs.run_at(0, 1, 15)) != 30) {
+      throw std::runtime_error("Run lookup is wrong");
+    }
+    if (!runs.window_is('o', 0, 2, 0, 1, 0, 39) ||
+        runs.window_is('o', 0, 2, 0, 1, 0, 40) ||
+        !runs.window_is('w', 0, 1, 1, 2, 10, 30) ||
+        runs.window_is('w', 0, 1, 1, 2, 9, 30)) {
+      throw std::runtime_error("Run window check is wrong");
+    }
+
+    char decoded[40];
+    runs.decode(0, 1, 5, 35, decoded);
+    if (std::string(decoded, 30) != rows[1].substr(5, 30)) {
+      throw std::runtime_error("Run decode is wrong");
+    }
+
+    for (const char* path : {"tests/data/case1.txt", "tests/data/case2.txt"}) {
+      for (unsigned int threads : {1u, 4u}) {
+        if (compress_file(path, threads, GrowthStrategy::Greedy,
+                          OutputFormat::Text, SlabEncoding::Rle) !=
+            compress_file(path, 1)) {
+          throw std::runtime_error(std::string("RLE slab output differs for ") +
+                                   path);
+        }
+      }
+    }
+
+    std::cout << "✓ Run-length encoded slab test passed\n";
+  }
+
+  static void test_packed_slab() {
+    std::cout << "Testing packed tag id slabs...\n";
+
+    TagIds ids({{'w', "water"}, {'a', "air"}, {'o', "ocean"}});
+    if (ids.count() != 3 || ids.id('a') != 0 || ids.id('o') != 1 ||
+        ids.id('w') != 2 || ids.id('x') != -1 || ids.tag(2) != 'w') {
+      throw std::runtime_error("Tag ids are not dense in byte order");
+    }
+
+    PackedSlab packed;
+    packed.set_tags(ids);
+    packed.reset(2, 1, 7);
+    std::string rows[2] = {"oawwoao", "wwwwwwa"};
+    for (const std::string& row : rows) packed.append_row(row.data());
+    if (packed.byte_count() != 8 || packed.tag_at(0, 0, 1) != 'a' ||
+        packed.tag_at(1, 0, 6) != 'a') {
+      throw std::runtime_error("Packed lookup is wrong");
+    }
+
+    // Odd and even ends on both sides
+    for (int x0 = 0; x0 < 7; ++x0) {
+      for (int x1 = x0; x1 <= 7; ++x1) {
+        char decoded[7];
+        packed.decode(0, 0, x0, x1, decoded);
+        if (std::string(decoded, x1 - x0) != rows[0].substr(x0, x1 - x0)) {
+          throw std::runtime_error("Packed decode is wrong");
+        }
+      }
+    }
+
+    if (packed.append_row("oaoxooo") || packed.tag_at(1, 0, 6) != 'a') {
+      throw std::runtime_error("Tag outside the table was packed");
+    }
+
+    for (const char* path : {"tests/data/case1.txt", "tests/data/case2.txt"}) {
+      for (unsigned int threads : {1u, 4u}) {
+        if (compress_file(path, threads, GrowthStrategy::Greedy,
+                          OutputFormat::Text, SlabEncoding::Packed) !=
+            compress_file(path, 1)) {
+          throw std::runtime_error(
+              std::string("Packed slab output differs for ") + path);
+        }
+      }
+    }
+
+    // A tag outside the tag table, partway through case2's second slab,
+    // leaves that slab dense; every layout accepts it and writes the tag
+    std::string model = read_file("tests/data/case2.txt");
+    std::size_t slice = 16 * 65 + 1;
+    model[model.find("\n\n") + 2 + 3 * slice + 5 * 65 + 10] = 'x';
+    std::string path = std::filesystem::temp_directory_path().string() +
+                       "/block_model_untabled_tag.txt";
+    write_file(path, model);
+    std::string dense = compress_file(path, 1);
+    for (unsigned int threads : {1u, 4u}) {
+      if (compress_file(path, threads, GrowthStrategy::Greedy,
+                        OutputFormat::Text, SlabEncoding::Packed) != dense) {
+        throw std::runtime_error("Packed output differs with a tag outside the table");
+      }
+    }
+    if (dense.find(",x\n") == std::string::npos) {
+      throw std::runtime_error("Tag outside the table was not written");
+    }
+    std::remove(path.c_str());
+
+    std::cout << "✓ Packed tag id slab test passed\n";
+  }
+
+  static void test_block_merger() {
+    std::cout << "Testing cross-slab block merging...\n";
+
+    BlockList merged;
+    BlockMerger merger(MergeMode::Z, merged);
+    std::vector<Block> slab1 = {Block(0, 0, 0, 2, 2, 2, 'o'),
+                                Block(2, 0, 0, 2, 2, 1, 'w'),
+                                Block(2, 0, 1, 2, 2, 1, 'o')};
+    std::vector<Block> slab2 = {Block(0, 0, 2, 2, 2, 2, 'o'),
+                                Block(2, 0, 2, 2, 2, 2, 'o')};
+    merger.add_slab(slab1, 2);
+    merger.add_slab(slab2, 4);
+    merger.finish();
+
+    std::string got;
+    for (const Block& b : merged.blocks) {
+      got += std::to_string(b.x) + "," + std::to_string(b.z) + "," +
+             std::to_string(b.depth) + b.tag + " ";
+    }
+    if (got != "2,0,1w 0,0,4o 2,1,3o ") {
+      throw std::runtime_error("Merged blocks are wrong: " + got);
+    }
+
+    // A merged block can outgrow int; its volume must not wrap
+    Block whole(0, 0, 0, 4096, 4096, 64, 'o');
+    whole.set_depth(4096);
+    if (whole.volume != 4096LL * 4096 * 4096) {
+      throw std::runtime_error("Merged block volume overflowed");
+    }
+
+    for (MergeMode mode : {MergeMode::Z, MergeMode::XYZ}) {
+      for (unsigned int threads : {1u, 4u}) {
+        std::string output =
+            compress_file("tests/data/case1.txt", threads, GrowthStrategy::Greedy,
+                          OutputFormat::Text, SlabEncoding::Dense, mode);
+        int blocks = 0, reference_blocks = 0;
+        total_volume(compress_file("tests/data/case1.txt", 1), reference_blocks);
+        if (total_volume(output, blocks) != 64 * 8 * 5 ||
+            blocks >= reference_blocks) {
+          throw std::runtime_error("Merged case1 output is wrong");
+        }
+      }
+    }
+
+    std::cout << "✓ Cross-slab block merging test passed\n";
+  }
+
+  static void test_summed_volume_table() {
+    std::cout << "Testing summed-volume table...\n";
+
+    Flat3D<char> grid(3, 4, 5, 'o');
+    grid.at(1, 2, 3) = 'w';
+    grid.at(2, 0, 0) = 'w';
+
+    SummedVolumeTable tags;
+    tags.build(grid, 'o');
+    if (tags.sum(0, 3, 0, 4, 0, 5) != 58 || tags.sum(1, 2, 2, 3, 3, 4) != 0 ||
+        tags.sum(0, 2, 0, 2, 0, 2) != 8) {
+      throw std::runtime_error("Summed-volume tag counts are wrong");
+    }
+
+    std::cout << "✓ Summed-volume table test passed\n";
+  }
 };
 
 int main() {
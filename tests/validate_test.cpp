@@ -1,127 +1,104 @@
-#include <cctype>
+#include "block_validator.h"
+#include <climits>
+#include <fstream>
 #include <iostream>
+#include <stdexcept>
 #include <string>
-#include <unordered_map>
-#include <vector>
 
-// Dimensions match python script
-static constexpr int WIDTH = 65;
-static constexpr int HEIGHT = 16;
-static constexpr int DEPTH = 5;
+// Validates compressed output against the model it came from:
+//   block_model < model.txt | validate_test model.txt
+// Exits 0 if the blocks tile the model exactly with the right labels.
+static void print_usage(const char* prog) {
+  std::cerr << "Usage: " << prog
+            << " [--threads N] [--allow-merged] [--max-open-slabs N] MODEL [OUTPUT]\n"
+            << "  MODEL   the compressor's input (spec, tag table, model)\n"
+            << "  OUTPUT  its text or binary output (default: stdin)\n";
+}
 
-static inline std::string trim(const std::string& s) {
-  size_t a = 0, b = s.size();
-  while (a < b && std::isspace(static_cast<unsigned char>(s[a])))
-    ++a;
-  while (b > a && std::isspace(static_cast<unsigned char>(s[b - 1])))
-    --b;
-  return s.substr(a, b - a);
+// Parses a positive decimal count, as block_model does; false on a sign,
+// stray characters or overflow
+static bool parse_count(const char* s, int& out) {
+  if (*s < '0' || *s > '9') return false;
+  long long v = 0;
+  for (; *s >= '0' && *s <= '9'; ++s) {
+    v = v * 10 + (*s - '0');
+    if (v > INT_MAX) return false;
+  }
+  if (*s != '\0' || v < 1) return false;
+  out = static_cast<int>(v);
+  return true;
 }
 
-int main() {
+int main(int argc, char* argv[]) {
   std::ios::sync_with_stdio(false);
   std::cin.tie(nullptr);
 
-  // model[z][y][x]
-  std::vector<std::vector<std::vector<char>>> model(
-      DEPTH,
-      std::vector<std::vector<char>>(HEIGHT, std::vector<char>(WIDTH, '\0')));
-  std::vector<std::vector<std::vector<bool>>> seen(
-      DEPTH,
-      std::vector<std::vector<bool>>(HEIGHT, std::vector<bool>(WIDTH, false)));
-
-  // label -> char (same as Python label_table)
-  std::unordered_map<std::string, char> label_table = {
-      {"sea", 'o'}, {"WA", 'w'},  {"NT", 'n'},  {"SA", 's'},
-      {"QLD", 'q'}, {"NSW", 'e'}, {"VIC", 'v'}, {"TAS", 't'}};
-
-  std::string line;
-  while (true) {
-    if (!std::getline(std::cin, line))
-      break; // EOF
-    if (!line.empty() && line.back() == '\r')
-      line.pop_back();
-    line = trim(line);
-    if (line.empty())
-      break;
-
-    // Split by commas
-    std::vector<std::string> parts;
-    {
-      std::string cur;
-      for (char c : line) {
-        if (c == ',') {
-          parts.push_back(trim(cur));
-          cur.clear();
-        } else {
-          cur.push_back(c);
-        }
+  int threads = 1;
+  bool allow_merged = false;
+  int max_open_slabs = 0;
+  std::string model_path, output_path;
+  for (int i = 1; i < argc; ++i) {
+    std::string arg = argv[i];
+    if (arg == "--threads" && i + 1 < argc) {
+      if (!parse_count(argv[++i], threads)) {
+        print_usage(argv[0]);
+        return 2;
       }
-      parts.push_back(trim(cur));
-    }
-
-    if (parts.size() != 7) {
-      std::cerr << "Invalid line (need 7 fields): " << line << "\n";
-      continue;
-    }
-
-    int x = std::stoi(parts[0]);
-    int y = std::stoi(parts[1]);
-    int z = std::stoi(parts[2]);
-    int bw = std::stoi(parts[3]);
-    int bh = std::stoi(parts[4]);
-    int bd = std::stoi(parts[5]);
-    std::string label = parts[6];
-
-    auto it = label_table.find(label);
-    if (it == label_table.end()) {
-      std::cerr << "Unknown label \"" << label << "\"; skipping line.\n";
-      continue;
-    }
-    char tag = it->second;
-
-    // Fill the block; warn if any voxel is written twice
-    for (int dz = 0; dz < bd; ++dz) {
-      int zz = z + dz;
-      if (zz < 0 || zz >= DEPTH)
-        continue; // or report error
-      for (int dy = 0; dy < bh; ++dy) {
-        int yy = y + dy;
-        if (yy < 0 || yy >= HEIGHT)
-          continue;
-        for (int dx = 0; dx < bw; ++dx) {
-          int xx = x + dx;
-          if (xx < 0 || xx >= WIDTH)
-            continue;
-
-          if (seen[zz][yy][xx]) {
-            std::cout << "(" << xx << ", " << yy << ", " << zz
-                      << ") appears twice\n";
-          }
-          seen[zz][yy][xx] = true;
-          model[zz][yy][xx] = tag;
-        }
+    } else if (arg == "--allow-merged") {
+      allow_merged = true;
+    } else if (arg == "--max-open-slabs" && i + 1 < argc) {
+      if (!parse_count(argv[++i], max_open_slabs)) {
+        print_usage(argv[0]);
+        return 2;
       }
+    } else if (model_path.empty() && arg[0] != '-') {
+      model_path = arg;
+    } else if (output_path.empty() && arg[0] != '-') {
+      output_path = arg;
+    } else {
+      print_usage(argv[0]);
+      return 2;
     }
   }
+  if (model_path.empty()) {
+    print_usage(argv[0]);
+    return 2;
+  }
 
-  // Print the 3D model like the Python script:
-  // each slice z -> HEIGHT rows of WIDTH chars, '-' for empty, blank line
-  // between slices
-  for (int z = 0; z < DEPTH; ++z) {
-    for (int y = 0; y < HEIGHT; ++y) {
-      for (int x = 0; x < WIDTH; ++x) {
-        char c = model[z][y][x];
-        if (c == '\0') {
-          std::cout << '-';
-        } else {
-          std::cout << c;
-        }
-      }
-      std::cout << "\n";
+  std::ifstream model(model_path, std::ios::binary);
+  if (!model.is_open()) {
+    std::cerr << "Cannot open " << model_path << "\n";
+    return 2;
+  }
+  std::ifstream output_file;
+  if (!output_path.empty()) {
+    output_file.open(output_path, std::ios::binary);
+    if (!output_file.is_open()) {
+      std::cerr << "Cannot open " << output_path << "\n";
+      return 2;
     }
-    std::cout << "\n";
   }
 
-  return 0;
-}
\ No newline at end of file
+  ValidationReport report;
+  try {
+    BlockValidator validator(model);
+    validator.set_num_threads(static_cast<unsigned int>(threads));
+    validator.set_allow_parent_crossing(allow_merged);
+    if (max_open_slabs) validator.set_max_open_slabs(static_cast<std::size_t>(max_open_slabs));
+    report = validator.validate(output_path.empty() ? std::cin : output_file);
+  } catch (const std::exception& e) {
+    std::cerr << e.what() << "\n";
+    return 2;
+  }
+
+  for (const std::string& e : report.errors)
+    std::cout << e << "\n";
+  std::cout << report.blocks << " blocks cover " << report.covered_voxels
+            << " voxels; " << report.gap_voxels << " gap, "
+            << report.overlap_voxels << " overlapping, "
+            << report.mismatch_voxels << " mislabelled voxels; "
+            << report.bad_blocks << " bad blocks, " << report.parent_crossings
+            << " crossing parent blocks\n"
+            << (report.ok() ? "OK" : "FAILED") << "\n";
+  return report.ok() ? 0 : 1;
+}